@@ -5,7 +5,16 @@
  *      Author: perra
  */
 
-#include "PnPContoller_Main.h"
+#include <math.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "nuts_bolts.h"
+#include "GCode.h"
+#include "cycle_probe.h"
 
 
 /*
@@ -20,8 +29,8 @@
 	G21							mm for length unit
 	G28							Home all axes
 	F							Feedrate
-	M62 P						Turn digital output on
-	M63 P						Turn digital output off
+	M62 P Q						Turn digital output on Q mm along the next move, from its end if Q < 0
+	M63 P Q						Turn digital output off Q mm along the next move, from its end if Q < 0
 	M66 PELQ					Wait for digital input
 	M67 PELQ					Wait for analog input
 	M400						Wait for move to complete
@@ -39,6 +48,7 @@
 #define FAIL(status) return(status);
 
 parser_state_t gc_state;
+tool_data_t tool_table;
 typedef enum {
     AxisCommand_None = 0,
     AxisCommand_NonModal,
@@ -49,7 +59,9 @@ typedef enum {
 
 static scale_factor_t scale_factor;
 static gc_thread_data thread;
-static output_command_t *output_commands = NULL; // Linked list
+static output_command_t output_commands[GC_MAX_OUTPUTS]; // Waiting for the next motion block
+static uint_fast8_t n_output_commands = 0;
+static gc_block_sink_ptr block_sink = NULL;      // Receives validated motion blocks
 
 // Simple hypotenuse computation function.
 inline static float hypot_f (float x, float y)
@@ -125,11 +137,7 @@ void gc_init(bool cold_start)
     }
 
     // Clear any pending output commands
-    while(output_commands) {
-        output_command_t *next = output_commands->next;
-        free(output_commands);
-        output_commands = next;
-    }
+    n_output_commands = 0;
 
     // Load default override status
 //    gc_state.modal.override_ctrl = sys.override.control;
@@ -149,100 +157,194 @@ void gc_init(bool cold_start)
 //    if(settings.flags.lathe_mode)
 //        gc_state.modal.plane_select = PlaneSelect_ZX;
 }
-// Add output command to linked list
+// Add output command for the next motion block, false if too many are waiting
 static bool add_output_command (output_command_t *command)
 {
-    output_command_t *add_cmd;
+    if(n_output_commands == GC_MAX_OUTPUTS)
+        return false;
+
+    memcpy(&output_commands[n_output_commands++], command, sizeof(output_command_t));
+
+    return true;
+}
+
+// Route a block to the controller of a port, 50 ports per controller
+static void set_port_controller (controller_t *controlers, uint8_t port)
+{
+    if(port > 149) controlers->Ctrl_Feeder2 = true;
+    else if(port > 99) controlers->Ctrl_Feeder1 = true;
+    else if(port > 49) controlers->Ctrl_Head = true;
+    else controlers->Ctrl_Base = true;
+}
+
+// Attach an output command to the motion of a block and route the block to the controller of
+// its port, false if the block has too many
+bool gc_block_add_output (parser_block_t *block, const output_command_t *command)
+{
+    if(block->n_output_commands == GC_MAX_OUTPUTS)
+        return false;
 
-    if((add_cmd = malloc(sizeof(output_command_t)))) {
+    memcpy(&block->output_commands[block->n_output_commands++], command, sizeof(output_command_t));
+    set_port_controller(&block->controlers, command->port);
+
+    return true;
+}
 
-        memcpy(add_cmd, command, sizeof(output_command_t));
+// Convert the digits collected by gc_scan_line() to a float, same rules as read_float()
+inline static float scan_float (uint32_t intval, int_fast8_t exp, bool isnegative)
+{
+    float fval = (float)intval;
 
-        if(output_commands == NULL)
-            output_commands = add_cmd;
-        else {
-            output_command_t *cmd = output_commands;
-            while(cmd->next)
-                cmd = cmd->next;
-            cmd->next = add_cmd;
+    if (fval != 0.0f) {
+        while (exp <= -2) {
+            fval *= 0.01f;
+            exp += 2;
         }
+        if (exp < 0)
+            fval *= 0.1f;
+        else if (exp > 0) do {
+            fval *= 10.0f;
+        } while (--exp > 0);
     }
 
-    return add_cmd != NULL;
+    return isnegative ? - fval : fval;
 }
 
-//****************************************************************************
-/**
- * compressInstring
- *
- * @param dataptr pointer to the application buffer that contains the data to send
- * @param size size of the application data to send
- * @param apiflags combination of following flags :
- * - NETCONN_COPY: data will be copied into memory belonging to the stack
- * - NETCONN_MORE: for TCP connection, PSH flag will be set on last segment sent
- * - NETCONN_DONTBLOCK: only write the data if all data can be written at once
- * @param bytes_written pointer to a location that receives the number of written bytes
- * @return ERR_OK if data was sent, any other err_t on error
- */
-void compressInstring(char *dataptr, u16_t *len, char *outbuff)
+// Single pass scanner, replaces compressInstring() + the read_float() loop in parseBlock().
+// Reads one line straight from the receive buffer, skips blanks and comments, uppercases
+// letters and stores the word/value pairs in line. The input is not modified.
+status_code_t gc_scan_line (const char *data, uint16_t len, gc_line_t *line)
 {
-	u16_t i,j;
-	uint8_t comment, addch;
-
-	comment = 0;
-	j = 0;
-
-	for (i=0; i<*len; i++)
-	{
-		addch = 1;
-		// Remove blanks and special characters
-		if(*dataptr == '\n' || *dataptr == '\r' || *dataptr == ' '  || *dataptr == '\0' )
-		{
-			addch=0;
-		}
-		// Remove comments
-		if(*dataptr == ';')
-		{
-			i=*len;
-			addch=0;
-		}
-		if(*dataptr == '(')
-		{
-			comment=1;
-			addch=0;
-		}
-		// Make Upper case
-		if((*dataptr >= 'a') && (*dataptr <= 'z'))
-		{
-			*dataptr &= 0b01011111;
-		}
-		// Add the character
-		if(addch && !comment)
-		{
-			*outbuff = *dataptr;
-			outbuff ++;
-			j++;
-		}
-
-		// Remove comment flag
-		if(*dataptr == ')')
-		{
-			comment=0;
-		}
-		dataptr ++;
-	}
-	*outbuff = '\0';
-	(*len) = j;
-	return;
+    const char *end = data + len;
+    gc_word_t *word = NULL;
+    uint32_t intval = 0;
+    int_fast8_t exp = 0;
+    uint_fast8_t ndigit = 0;
+    bool comment = false, isnegative = false, isdecimal = false, signed_ok = false;
+    char c;
+
+    line->n_words = 0;
+    line->jog_motion = false;
+    line->program_demarcation = false;
 
+    while (data < end) {
+
+        c = *data++;
+
+        if (comment) {
+            comment = c != ')';
+            continue;
+        }
+
+        switch (c) {
+
+            case '(':
+                comment = true;
+                continue;
+
+            case ';': // Rest of line is a comment
+                data = end;
+                continue;
+
+            case ' ': case '\t': case '\r': case '\n': case '\0':
+                continue;
+
+            case '$': // NOTE: only `$J=` jog lines are handled here
+                if (line->n_words || line->jog_motion || line->program_demarcation ||
+                     end - data < 2 || CAPS(data[0]) != 'J' || data[1] != '=')
+                    return Status_InvalidStatement;
+                line->jog_motion = true;
+                data += 2;
+                continue;
+
+            case CMD_PROGRAM_DEMARCATION:
+                if (line->n_words || line->jog_motion || line->program_demarcation)
+                    return Status_ExpectedCommandLetter;
+                line->program_demarcation = true;
+                continue;
+        }
+
+        if ((uint_fast8_t)(c - '0') <= 9) {
+            if (word == NULL)
+                return Status_ExpectedCommandLetter; // [Expected word letter]
+            signed_ok = false;
+            if (++ndigit <= MAX_INT_DIGITS) {
+                if (isdecimal)
+                    exp--;
+                intval = (((intval << 2) + intval) << 1) + (c - '0'); // intval*10 + c
+            } else if (!isdecimal)
+                exp++;  // Drop overflow digits
+            continue;
+        }
+
+        if (word && c == '.' && !isdecimal) {
+            isdecimal = true;
+            signed_ok = false;
+            continue;
+        }
+
+        if (word && signed_ok && (c == '-' || c == '+')) {
+            isnegative = c == '-';
+            signed_ok = false;
+            continue;
+        }
+
+        c = CAPS(c);
+        if (c < 'A' || c > 'Z' || line->program_demarcation)
+            return Status_ExpectedCommandLetter; // [Expected word letter]
+
+        // New word, complete the previous one
+        if (word) {
+            if (!ndigit)
+                return Status_BadNumberFormat; // [Expected word value]
+            word->value = scan_float(intval, exp, isnegative);
+        }
+
+        if (line->n_words == GC_MAX_WORDS)
+            return Status_LineLengthExceeded;
+
+        word = &line->word[line->n_words++];
+        word->letter = c;
+        intval = 0;
+        exp = 0;
+        ndigit = 0;
+        isnegative = isdecimal = false;
+        signed_ok = true;
+    }
+
+    if (word) {
+        if (!ndigit)
+            return Status_BadNumberFormat; // [Expected word value]
+        word->value = scan_float(intval, exp, isnegative);
+    }
+
+    return Status_OK;
+}
+
+// Set the receiver of validated motion blocks, NULL discards them
+void gc_set_block_sink(gc_block_sink_ptr sink)
+{
+    block_sink = sink;
+}
+
+// Scan and execute a NUL terminated line
+status_code_t parseBlock (char *block, char *message)
+{
+    static gc_line_t line;
+    status_code_t status;
+
+    if ((status = gc_scan_line(block, (uint16_t)strlen(block), &line)) == Status_OK)
+        status = parseTokens(&line, message);
+
+    return status;
 }
 
 // From grblHAL
-void parseBlock(char *block, char *message)
+status_code_t parseTokens (const gc_line_t *line, char *message)
 {
+    PROBE_SCOPE(Probe_ParseTokens);
 
     static parser_block_t gc_block;
-	extern QueueHandle_t xPlannerQueue;
 
     // Determine if the line is a program start/end marker.
     // Old comment from protocol.c:
@@ -250,7 +352,7 @@ void parseBlock(char *block, char *message)
     // where, during a program, the system auto-cycle start will continue to execute
     // everything until the next '%' sign. This will help fix resuming issues with certain
     // functions that empty the planner buffer to execute its task on-time.
-    if (block[0] == CMD_PROGRAM_DEMARCATION && block[1] == '\0') {
+    if (line->program_demarcation) {
         gc_state.file_run = !gc_state.file_run;
         return Status_OK;
     }
@@ -280,7 +382,7 @@ void parseBlock(char *block, char *message)
        gc_parser_flags_t gc_parser_flags = {0};
 
        // Determine if the line is a jogging motion or a normal g-code block.
-       if (block[0] == '$') { // NOTE: `$J=` already parsed when passed to this function.
+       if (line->jog_motion) { // NOTE: `$J=` already stripped by gc_scan_line().
            // Set G1 and G94 enforced modes to ensure accurate error checks.
            gc_parser_flags.jog_motion = On;
            gc_block.modal.motion = MotionMode_Linear;
@@ -297,20 +399,17 @@ void parseBlock(char *block, char *message)
           words, and for negative values set for the value words F, N, P, T, and S. */
 
          word_bit_t word_bit; // Bit-value for assigning tracking variables
-         uint_fast8_t char_counter = gc_parser_flags.jog_motion ? 3 /* Start parsing after `$J=` */ : 0;
+         const gc_word_t *word = line->word, *last_word = line->word + line->n_words;
          char letter;
          float value;
          uint_fast16_t int_value = 0;
          uint_fast16_t mantissa = 0;
 
-         while ((letter = block[char_counter++]) != '\0') { // Loop until no more g-code words in block.
-
-             // Import the next g-code word, expecting a letter followed by a value. Otherwise, error out.
-             if((letter < 'A') || (letter > 'Z'))
-                 FAIL(Status_ExpectedCommandLetter); // [Expected word letter]
+         for (; word < last_word; word++) { // Loop until no more g-code words in block.
 
-             if (!read_float(block, &char_counter, &value))
-                 FAIL(Status_BadNumberFormat); // [Expected word value]
+             // Words are validated by gc_scan_line(): letter is in A-Z and followed by a value.
+             letter = word->letter;
+             value = word->value;
 
              // Convert values to smaller uint8 significand and mantissa values for parsing this word.
              // NOTE: Mantissa is multiplied by 100 to catch non-integer command values. This is more
@@ -529,6 +628,11 @@ void parseBlock(char *block, char *message)
                               port_command = int_value;
                               break;
 
+                          case 400:
+                              word_bit.group = ModalGroup_M4;
+                              gc_block.sync = true;
+                              break;
+
                           default:
                                   FAIL(Status_GcodeUnsupportedCommand); // [Unsupported M command]
                       } // end M-value switch
@@ -651,6 +755,7 @@ void parseBlock(char *block, char *message)
                           case 'Z':
                               word_bit.parameter = Word_Z;
                               gc_block.values.xyz[Z_AXIS] = value;
+                              gc_block.controlers.Ctrl_Head = true;
                               bit_true(axis_words, bit(Z_AXIS));
                               break;
 
@@ -837,12 +942,10 @@ void parseBlock(char *block, char *message)
                        gc_block.output_command.is_digital = true;
                        gc_block.output_command.port = (uint8_t)gc_block.values.p;
                        gc_block.output_command.value = port_command == 62 || port_command == 64 ? 1.0f : 0.0f;
-                       bit_false(value_words, bit(Word_P));
+                       gc_block.output_command.distance = gc_block.values.q;
+                       bit_false(value_words, bit(Word_P)|bit(Word_Q));
 
-                       if((uint8_t)gc_block.values.p > 149) gc_block.controlers.Ctrl_Feeder2 = true;
-                       else if((uint8_t)gc_block.values.p > 99) gc_block.controlers.Ctrl_Feeder1 = true;
-                       else if((uint8_t)gc_block.values.p > 49) gc_block.controlers.Ctrl_Head = true;
-                       else gc_block.controlers.Ctrl_Base = true;
+                       set_port_controller(&gc_block.controlers, gc_block.output_command.port);
                        break;
 
                    case 64:
@@ -895,10 +998,7 @@ void parseBlock(char *block, char *message)
 
                        bit_false(value_words, bit(Word_E)|bit(Word_L)|bit(Word_P)|bit(Word_Q));
 
-                       if(gc_block.output_command.port > 149) gc_block.controlers.Ctrl_Feeder2 = true;
-                       else if(gc_block.output_command.port > 99) gc_block.controlers.Ctrl_Feeder1 = true;
-                       else if(gc_block.output_command.port > 49) gc_block.controlers.Ctrl_Head = true;
-                       else gc_block.controlers.Ctrl_Base = true;
+                       set_port_controller(&gc_block.controlers, gc_block.output_command.port);
                        break;
 
                    case 68:
@@ -911,10 +1011,7 @@ void parseBlock(char *block, char *message)
                        gc_block.output_command.value = gc_block.values.q;
                        bit_false(value_words, bit(Word_E)|bit(Word_Q));
 
-                       if((uint8_t)gc_block.values.e > 149) gc_block.controlers.Ctrl_Feeder2 = true;
-                       else if((uint8_t)gc_block.values.e > 99) gc_block.controlers.Ctrl_Feeder1 = true;
-                       else if((uint8_t)gc_block.values.e > 49) gc_block.controlers.Ctrl_Head = true;
-                       else gc_block.controlers.Ctrl_Base = true;
+                       set_port_controller(&gc_block.controlers, gc_block.output_command.port);
                    break;
                }
            }
@@ -1342,7 +1439,8 @@ void parseBlock(char *block, char *message)
 
                    case 62:
                    case 63:
-                       add_output_command(&gc_block.output_command);
+                       if(!add_output_command(&gc_block.output_command))
+                           FAIL(Status_Overflow);
                        break;
 
                    case 64:
@@ -1355,7 +1453,8 @@ void parseBlock(char *block, char *message)
                        break;
 
                    case 67:
-                       add_output_command(&gc_block.output_command);
+                       if(!add_output_command(&gc_block.output_command))
+                           FAIL(Status_Overflow);
                        break;
 
                    case 68:
@@ -1479,10 +1578,15 @@ void parseBlock(char *block, char *message)
 
            if (gc_state.modal.motion != MotionMode_None && axis_command == AxisCommand_MotionMode) {
 
-//               plan_data.output_commands = output_commands;
-               output_commands = NULL;
+               // Outputs queued since the last motion are switched along this one
+               for(idx = 0; idx < n_output_commands; idx++)
+                   gc_block_add_output(&gc_block, &output_commands[idx]);
+               n_output_commands = 0;
 
                pos_update_t gc_update_pos = GCUpdatePos_Target;
+               status_code_t status = Status_OK;
+
+               gc_block.axis_words = axis_words;
 
                switch(gc_state.modal.motion) {
 
@@ -1492,15 +1596,16 @@ void parseBlock(char *block, char *message)
 //                           // check initial feed rate - fail if zero?
 //                       }
 //                       mc_line(gc_block.values.xyz, &plan_data);
-                	   printf("MotionMode_Linear\r\n");
+                       if(block_sink)
+                           status = block_sink(&gc_block);
                        break;
 
                    case MotionMode_Seek:
 //                       plan_data.condition.rapid_motion = On; // Set rapid motion condition flag.
 //                       mc_line(gc_block.values.xyz, &plan_data);
 
-                	   mc_line(&gc_block);
-                	   printf("MotionMode_Seek\r\n");
+                       if(block_sink)
+                           status = block_sink(&gc_block);
 
                        break;
 
@@ -1570,13 +1675,9 @@ void parseBlock(char *block, char *message)
 //               if(sys.cancel)
 //                   gc_update_pos = GCUpdatePos_None;
 
-               //  Clean out any remaining output commands (may linger on error)
-               //TODO hanging in ininit loop
-//               while(plan_data.output_commands) {
-//                   output_command_t *next = plan_data.output_commands;
-//                   free(plan_data.output_commands);
-//                   plan_data.output_commands = next;
-//               }
+               // Block was not accepted downstream (planner queue full), keep the old position
+               if(status != Status_OK)
+                   FAIL(status);
 
                // As far as the parser is concerned, the position is now == target. In reality the
                // motion control system might still be processing the action and the real tool position
@@ -1587,6 +1688,12 @@ void parseBlock(char *block, char *message)
 //                   gc_sync_position(); // gc_state.position[] = sys_position
                // == GCUpdatePos_None
            }
+           else if (gc_block.sync && block_sink) {
+               // M400 without motion, goes to the planner on its own as a barrier
+               status_code_t status = block_sink(&gc_block);
+               if(status != Status_OK)
+                   FAIL(status);
+           }
 
 //           if(plan_data.message)
 //               protocol_message(plan_data.message);
@@ -1655,11 +1762,7 @@ void parseBlock(char *block, char *message)
 //                   }
 
                    // Clear any pending output commands
-                   while(output_commands) {
-                       output_command_t *next = output_commands->next;
-                       free(output_commands);
-                       output_commands = next;
-                   }
+                   n_output_commands = 0;
 
 //                   hal.report.feedback_message(Message_ProgramEnd);
                }
@@ -1670,44 +1773,3 @@ void parseBlock(char *block, char *message)
 
            return Status_OK;
 }
-/*-----------------------------------------------------------------------------------*/
-static void
-gcode_thread(void *arg)
-{
-  extern QueueHandle_t xInQueue;
-
-  char inbuff[50];
-  char message[50];
-  LWIP_UNUSED_ARG(arg);
-
-  xInQueue = xQueueCreate(10, 50);
-  if( xInQueue == NULL )
-  {
-  	PRINTF("Could not create InQueue");
-  }
-  vTaskDelay(1000);
-  if( xInQueue != NULL )
-  {
-	 for( ;; )
-	 {
-		// Get new GCode line from queue
-		if (xQueueReceive(xInQueue, &inbuff, portMAX_DELAY ) == pdPASS)
-		{
-//			printf("%s", inbuff);
-//			printf("\r\n");
-			parseBlock(&inbuff, &message);
-
-		}
-	}
-     vTaskDelay(1);
-  }
-
-}
-/*-----------------------------------------------------------------------------------*/
-void
-gcode_init(void)
-{
-  sys_thread_new("gcode_thread", gcode_thread, NULL, 500, 10);
-}
-/*-----------------------------------------------------------------------------------*/
-
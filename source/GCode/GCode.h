@@ -8,7 +8,12 @@
 #ifndef GCODE_GCODE_H_
 #define GCODE_GCODE_H_
 
-#include "lwip/opt.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nuts_bolts.h"
+
 // Define Grbl status codes. Valid values (0-255)
 typedef enum {
     Status_OK = 0,
@@ -258,9 +263,14 @@ typedef struct output_command {
     bool is_digital;
     uint8_t port;
     int32_t value;
-    struct output_command *next;
+    float distance;     // M62/M63 Q, mm along the next move, from its end when negative
 } output_command_t;
 
+// Output commands held for the next motion block
+#ifndef GC_MAX_OUTPUTS
+#define GC_MAX_OUTPUTS 4
+#endif
+
 typedef enum {
     WaitMode_Immediate = 0,
     WaitMode_Rise,
@@ -493,7 +503,11 @@ typedef struct {
     gc_modal_t modal;
     gc_values_t values;
     controller_t controlers;
+    uint8_t axis_words;                 // Axes with a word in the block, bit(X_AXIS) etc.
+    bool sync;                          // M400, later blocks wait until every controller is done
     output_command_t output_command;
+    output_command_t output_commands[GC_MAX_OUTPUTS];   // Switched along this motion, M62/M63
+    uint8_t n_output_commands;
 
 //    override_mode_t override_command; // TODO: add to non_modal above?
 //    user_mcode_t user_mcode;
@@ -505,6 +519,38 @@ typedef struct {
 // limit pull-off routines.
 #define gc_sync_position() system_convert_array_steps_to_mpos (gc_state.position, sys_position)
 
-void compressInstring(char *dataptr, u16_t *len, char *outbuff);
+// Max number of words in a block, a pick-and-place line rarely has more than six.
+#ifndef GC_MAX_WORDS
+#define GC_MAX_WORDS 16
+#endif
+
+// A g-code word, letter is uppercase A-Z.
+typedef struct {
+    char letter;
+    float value;
+} gc_word_t;
+
+// A line as tokenized by gc_scan_line(), this is what is queued between ingest and parser.
+typedef struct {
+    uint32_t seq;               // Ingest sequence number, echoed back in the acknowledge
+    uint8_t n_words;
+    bool jog_motion;            // Line started with $J=
+    bool program_demarcation;   // Line was a single %
+    gc_word_t word[GC_MAX_WORDS];
+} gc_line_t;
+
+// Size of a line with n_words words, only this much is stored in the input buffer
+#define GC_LINE_SIZE(n_words) (offsetof(gc_line_t, word) + (n_words) * sizeof(gc_word_t))
+
+// Receives every validated motion block from the parser. Keeps the parser free of
+// FreeRTOS and lwIP so that it can be linked into the host tools as well.
+typedef status_code_t (*gc_block_sink_ptr)(parser_block_t *gc_block);
+
+void gc_init(bool cold_start);
+void gc_set_block_sink(gc_block_sink_ptr sink);
+status_code_t gc_scan_line(const char *data, uint16_t len, gc_line_t *line);
+status_code_t parseTokens(const gc_line_t *line, char *message);
+status_code_t parseBlock(char *block, char *message);
+bool gc_block_add_output(parser_block_t *block, const output_command_t *command);
 
 #endif /* GCODE_GCODE_H_ */
@@ -43,7 +43,64 @@
 #define CMD_CYCLE_START_LEGACY '~'
 #define CMD_FEED_HOLD_LEGACY '!'
 #define CMD_PROGRAM_DEMARCATION '%'
+#define CMD_OVERRIDE_FEED_RESET 0x90         // Restores feed override value to 100%.
+#define CMD_OVERRIDE_FEED_COARSE_PLUS 0x91
+#define CMD_OVERRIDE_FEED_COARSE_MINUS 0x92
+#define CMD_OVERRIDE_FEED_FINE_PLUS 0x93
+#define CMD_OVERRIDE_FEED_FINE_MINUS 0x94
 
+// Configure feed override limits and increments. The override stretches the step periods of all
+// base motion, rapids included, so it can only slow the base down: the plan already runs the axes
+// at their limits. The maximum can not be raised above 100%.
+#define DEFAULT_FEED_OVERRIDE           100 // 100%. Don't change this value.
+#define MAX_FEED_RATE_OVERRIDE          100 // Percent of programmed feed rate (10-100).
+#define MIN_FEED_RATE_OVERRIDE           10 // Percent of programmed feed rate (1-100). Usually 10%.
+#define FEED_OVERRIDE_COARSE_INCREMENT   10 // (1-99). Usually 10%.
+#define FEED_OVERRIDE_FINE_INCREMENT      1 // (1-99). Usually 1%.
+
+// Feed hold decelerates coordinated base motion at the smallest acceleration of the base axes and
+// async rapids at the acceleration of each axis. A held async axis polls for the resume this often.
+#define FEED_HOLD_POLL_US 1000
+
+
+// Bytes of tokenized lines buffered between telnet ingest and the parser (FreeRTOS message
+// buffer). Lines are stored with only the words they contain, a typical pick-and-place move
+// takes 40-50 bytes including the length prefix.
+#ifndef INPUT_BUFFER_SIZE
+#define INPUT_BUFFER_SIZE 2048
+#endif
+
+// Flow control window advertised to the host: number of lines it may have unacknowledged.
+// If the lines are longer than typical the input buffer fills first and TCP holds the rest.
+#ifndef INPUT_WINDOW_LINES
+#define INPUT_WINDOW_LINES 32
+#endif
+
+// Number of parsed blocks buffered between the parser and the planner.
+#define PLANNER_QUEUE_LENGTH 10
+
+// Minimum planner junction speed in mm/sec. Sets the default minimum junction speed the planner
+// plans to at every buffer block junction, except for starting from rest and end of the buffer,
+// which are always zero.
+#define MINIMUM_JUNCTION_SPEED 0.0f
+
+// Step periods of acceleration and deceleration are computed by the step ISR with Austin's
+// recurrence c(n) = c(n-1) - 2c(n-1)/(4n+1), so a ramp is one segment no matter its length.
+// Comment out to interpolate the period linearly over SEGMENT_TIME_US segments instead.
+#define STEP_TIMING_RECURRENCE
+
+// Step timer backend, see step_timer.h. The PIT is used unless one of these is defined, host
+// builds define STEP_TIMER_SIM instead.
+//#define STEP_TIMER_QTMR
+
+// Minimum width of the step pulses in ns. The ISR lowers the step pins at its end and only waits
+// for the part of the pulse width it has not already spent. Raise it for drivers needing longer
+// pulses, 2500 for the DM542 class of drivers.
+#define STEP_PULSE_MIN_NS 1000
+
+// Cycle counter probes on the step ISR, the parser and the planner, see cycle_probe.h. Dumped
+// over telnet with $PR. Comment out to compile them out.
+//#define CYCLE_PROBES
 
 // System motion line numbers must be zero.
 #define JOG_LINE_NUMBER 0
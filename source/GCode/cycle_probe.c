@@ -0,0 +1,84 @@
+/*
+ * cycle_probe.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "cycle_probe.h"
+#include "placement.h"
+#include "fsl_device_registers.h"
+
+void cycle_counter_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->LAR = 0xC5ACCE55;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+#ifdef CYCLE_PROBES
+
+static const char * const probe_names[N_PROBES] = {
+	[Probe_StepISR] = "StepISR",
+	[Probe_ParseTokens] = "parseTokens",
+	[Probe_SubmitMoveBase] = "submitMoveBase",
+	[Probe_PlanBufferLine] = "plan_buffer_line",
+};
+
+static HOT_DATA probe_stats_t probes[N_PROBES];
+static HOT_DATA volatile bool reset[N_PROBES];
+
+HOT_CODE void cycle_probe_exit(probe_scope_t *scope)
+{
+	uint32_t cycles = DWT->CYCCNT - scope->start, bin = 0;
+	probe_stats_t *probe = &probes[scope->id];
+
+	if(reset[scope->id])
+	{
+		memset(probe, 0, sizeof(probe_stats_t));
+		reset[scope->id] = false;
+	}
+
+	if(cycles >> (PROBE_BIN_SHIFT + 1))
+	{
+		bin = 31 - __builtin_clz(cycles) - PROBE_BIN_SHIFT;
+		if(bin >= PROBE_BINS)
+			bin = PROBE_BINS - 1;
+	}
+
+	if(probe->count == 0 || cycles < probe->min)
+		probe->min = cycles;
+	if(cycles > probe->max)
+		probe->max = cycles;
+	probe->total += cycles;
+	probe->count++;
+	probe->histogram[bin]++;
+}
+
+const char *cycle_probe_name(probe_id_t id)
+{
+	return probe_names[id];
+}
+
+void cycle_probe_get(probe_id_t id, probe_stats_t *copy)
+{
+	memcpy(copy, &probes[id], sizeof(probe_stats_t));
+
+	// Not run since the reset was requested
+	if(reset[id])
+		memset(copy, 0, sizeof(probe_stats_t));
+}
+
+void cycle_probe_reset(void)
+{
+	uint_fast8_t idx;
+
+	for(idx = 0; idx < N_PROBES; idx++)
+		reset[idx] = true;
+}
+
+#endif
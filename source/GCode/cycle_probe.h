@@ -0,0 +1,73 @@
+/*
+ * cycle_probe.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Cycle counts of the step ISR and the parser and planner hot paths, taken with the DWT
+ *  cycle counter at the core clock. A probe covers the scope it is declared in, up to any
+ *  return out of it, and keeps the count, min, max and total of its runs and a histogram
+ *  of power of two bins. Each probe is only run from one task or ISR, it is the only
+ *  writer of its statistics. A copy taken while it runs may be off by the run being
+ *  recorded.
+ *
+ *  Compiled in with CYCLE_PROBES in config.h, PROBE_SCOPE() is empty without it.
+ */
+
+#ifndef GCODE_CYCLE_PROBE_H_
+#define GCODE_CYCLE_PROBE_H_
+
+#include <stdint.h>
+
+#include "config.h"
+
+typedef enum {
+	Probe_StepISR = 0,
+	Probe_ParseTokens,
+	Probe_SubmitMoveBase,			// Includes waiting for room in the look-ahead ring
+	Probe_PlanBufferLine,
+	N_PROBES
+} probe_id_t;
+
+#define PROBE_BINS 16				// Bin 0 below 64 cycles, bin n from 2^(n + 5) cycles, the last open ended
+#define PROBE_BIN_SHIFT 5
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	uint32_t histogram[PROBE_BINS];
+} probe_stats_t;
+
+// Starts the cycle counter, also used for the step pulse width
+void cycle_counter_init(void);
+
+#ifdef CYCLE_PROBES
+
+#include "fsl_device_registers.h"
+
+typedef struct {
+	probe_id_t id;
+	uint32_t start;
+} probe_scope_t;
+
+// Records the run of a scope, called when it goes out of scope
+void cycle_probe_exit(probe_scope_t *scope);
+
+#define PROBE_SCOPE(probe) probe_scope_t probe_scope __attribute__((cleanup(cycle_probe_exit))) = { (probe), DWT->CYCCNT }
+
+const char *cycle_probe_name(probe_id_t id);
+
+void cycle_probe_get(probe_id_t id, probe_stats_t *copy);
+
+// Cleared by each probe at its next run
+void cycle_probe_reset(void);
+
+#else
+
+#define PROBE_SCOPE(probe)
+
+#endif
+
+#endif /* GCODE_CYCLE_PROBE_H_ */
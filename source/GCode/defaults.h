@@ -25,4 +25,49 @@
 #define INVERT_LIMIT_PIN_MASK 0
 #endif
 
+// Junction deviation in mm, how far from the programmed corner the planner lets the path
+// deviate when deciding the speed through it.
+#define DEFAULT_JUNCTION_DEVIATION 0.01f
+
+// G0 rapids move each axis independently at its own max rate and acceleration, the move ends
+// when the slowest axis arrives. The path is not a straight line.
+#define DEFAULT_ASYNC_RAPIDS 1 // true
+
+// What the step ISR does when the step buffers are about to run dry mid-motion, see
+// underrun_response_t: 0 waits and ramps up again from rest, 1 feed holds with the steps still
+// queued and resumes once the stepper thread has caught up, 2 feed holds and raises ALARM:14,
+// resumed with cycle start. Every underrun is reported to the host.
+#define DEFAULT_UNDERRUN_RESPONSE 1 // decelerate
+
+// Base axes, belt driven X and Y. Acceleration is in mm/sec^2, rates in mm/min.
+#define DEFAULT_X_STEPS_PER_MM 80.0f
+#define DEFAULT_Y_STEPS_PER_MM 80.0f
+#define DEFAULT_Z_STEPS_PER_MM 400.0f
+#define DEFAULT_X_MAX_RATE 30000.0f // mm/min
+#define DEFAULT_Y_MAX_RATE 30000.0f // mm/min
+#define DEFAULT_Z_MAX_RATE 6000.0f // mm/min
+#define DEFAULT_X_ACCELERATION 5000.0f // mm/sec^2
+#define DEFAULT_Y_ACCELERATION 5000.0f // mm/sec^2
+#define DEFAULT_Z_ACCELERATION 2000.0f // mm/sec^2
+
+// Jerk limit of point to point moves in mm/sec^3, 0 keeps the trapezoidal profile. Acceleration
+// then ramps up over acceleration / jerk seconds instead of starting at once. It only settles
+// faster with that ramp a whole period of the resonance, jerk = acceleration * resonance, and
+// makes the move itself slower. tools/profile_sim, 5 mm at 2000 mm/s^2 and 40 Hz: trapezoid
+// 100 ms, 5.96 um residual, 13.48 ms settle; jerk 80000 128 ms, 4.05 um, no settle; jerk
+// 200000 110 ms, 19.88 um, 109.43 ms. Off until the resonance of the axis has been measured.
+#define DEFAULT_X_JERK 0.0f
+#define DEFAULT_Y_JERK 0.0f
+
+// Input shaping of point to point moves, 0 off, 1 ZV, 2 ZVD. The shaper cancels the ringing of
+// one resonance, measure it on the machine (tools/shaper_sim shows the trade offs). A ZV shaper
+// adds half a period of the resonance to each move, ZVD a full period but tolerates more error
+// in the frequency.
+#define DEFAULT_X_SHAPER 0 // off
+#define DEFAULT_Y_SHAPER 0 // off
+#define DEFAULT_X_SHAPER_FREQUENCY 40.0f // Hz
+#define DEFAULT_Y_SHAPER_FREQUENCY 40.0f // Hz
+#define DEFAULT_X_SHAPER_DAMPING 0.1f
+#define DEFAULT_Y_SHAPER_DAMPING 0.1f
+
 #endif /* GCODE_DEFAULTS_H_ */
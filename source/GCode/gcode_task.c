@@ -0,0 +1,69 @@
+/*
+ * gcode_task.c
+ *
+ *  Created on: 7 sep. 2020
+ *      Author: perra
+ *
+ *  FreeRTOS glue for the g-code parser. The parser itself lives in GCode.c
+ *  and has no RTOS dependencies.
+ */
+
+#include "PnPContoller_Main.h"
+
+#include "lwip/sys.h"
+#include "telnet.h"
+
+/*-----------------------------------------------------------------------------------*/
+static void
+gcode_thread(void *arg)
+{
+  extern MessageBufferHandle_t xInBuffer;
+  extern QueueHandle_t xAckQueue;
+
+  gc_line_t inbuff;
+  line_ack_t ack;
+  char message[50];
+  LWIP_UNUSED_ARG(arg);
+
+  gc_init(true);
+  gc_set_block_sink(mc_line);
+
+  // Variable length records, each line takes only the space of the words it holds
+  xInBuffer = xMessageBufferCreate(INPUT_BUFFER_SIZE);
+  if( xInBuffer == NULL )
+  {
+  	PRINTF("Could not create InBuffer");
+  }
+  // Room for the acks of a full window. A host exceeding it can make this fill up,
+  // telnet keeps draining acks while it waits for space in the input buffer.
+  xAckQueue = xQueueCreate(INPUT_WINDOW_LINES + 2, sizeof(line_ack_t));
+  if( xAckQueue == NULL )
+  {
+  	PRINTF("Could not create AckQueue");
+  }
+  vTaskDelay(1000);
+  if( xInBuffer != NULL && xAckQueue != NULL )
+  {
+	 for( ;; )
+	 {
+		// Get new GCode line from input buffer
+		if (xMessageBufferReceive(xInBuffer, &inbuff, sizeof(inbuff), portMAX_DELAY) >= GC_LINE_SIZE(0))
+		{
+			// Parse, blocks while the planner queue is full
+			ack.status = parseTokens(&inbuff, message);
+			ack.seq = inbuff.seq;
+
+			// Acknowledge, telnet sends it to the host
+			xQueueSendToBack(xAckQueue, &ack, portMAX_DELAY);
+		}
+	}
+  }
+
+}
+/*-----------------------------------------------------------------------------------*/
+void
+gcode_init(void)
+{
+  sys_thread_new("gcode_thread", gcode_thread, NULL, 500, 10);
+}
+/*-----------------------------------------------------------------------------------*/
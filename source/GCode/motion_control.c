@@ -39,9 +39,19 @@ status_code_t mc_jog_execute (plan_line_data_t *pl_data, parser_block_t *gc_bloc
 
 // Distribute commands to respective controller
 
+// Blocks while the planner queue is full, the line is not acknowledged to the host until
+// it has been queued so the host flow control window follows the planner.
 status_code_t mc_line(parser_block_t * gc_block)
 {
 	extern QueueHandle_t xPlannerQueue;
+	uint_fast8_t idx;
 
-	xQueueSendToBack(xPlannerQueue, gc_block, 0 );
+	// Counted before the line is acknowledged so the host connection keeps polling for them
+	for(idx = 0; idx < gc_block->n_output_commands; idx++)
+	{
+		if(plan_output_on_base(&gc_block->output_commands[idx]))
+			stepper_output_expected();
+	}
+
+	return xQueueSendToBack(xPlannerQueue, gc_block, portMAX_DELAY) == pdPASS ? Status_OK : Status_Overflow;
 }
@@ -11,4 +11,7 @@
 // Sets up valid jog motion received from g-code parser, checks for soft-limits, and executes the jog.
 status_code_t mc_jog_execute(plan_line_data_t *pl_data, parser_block_t *gc_block);
 
+// Queue a validated block for the planner. Installed as the parser block sink.
+status_code_t mc_line(parser_block_t *gc_block);
+
 #endif /* GCODE_MOTION_CONTROL_H_ */
@@ -0,0 +1,246 @@
+/*
+ * motion_profile.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include <math.h>
+
+#include "motion_profile.h"
+
+void profile_calculate(motion_profile_t *profile, uint32_t steps, float entry_rate, float cruise_rate, float exit_rate, float acceleration)
+{
+    float accel_dist, decel_dist, two_a = 2.0f * acceleration;
+
+    if(entry_rate > cruise_rate)
+        entry_rate = cruise_rate;
+    if(exit_rate > cruise_rate)
+        exit_rate = cruise_rate;
+
+    profile->steps = steps;
+    profile->entry_rate = entry_rate;
+    profile->exit_rate = exit_rate;
+    profile->acceleration = acceleration;
+
+    // Distance needed to reach cruise from entry and to get down to exit again, v^2 = v0^2 + 2as
+    accel_dist = (cruise_rate * cruise_rate - entry_rate * entry_rate) / two_a;
+    decel_dist = (cruise_rate * cruise_rate - exit_rate * exit_rate) / two_a;
+
+    if(accel_dist + decel_dist > (float)steps)
+    {
+        // Triangle, acceleration and deceleration curves meet before cruise is reached
+        accel_dist = ((float)steps + (exit_rate * exit_rate - entry_rate * entry_rate) / two_a) * 0.5f;
+        if(accel_dist < 0.0f)
+            accel_dist = 0.0f;
+        else if(accel_dist > (float)steps)
+            accel_dist = (float)steps;
+        cruise_rate = sqrtf(entry_rate * entry_rate + two_a * accel_dist);
+        decel_dist = (float)steps - accel_dist;
+    }
+
+    profile->cruise_rate = cruise_rate;
+    profile->accel_steps = (uint32_t)ceilf(accel_dist);
+    if(profile->accel_steps > steps)
+        profile->accel_steps = steps;
+    profile->decel_steps = (uint32_t)ceilf(decel_dist);
+    if(profile->decel_steps > steps - profile->accel_steps)
+        profile->decel_steps = steps - profile->accel_steps;
+}
+
+// Time to travel s steps from rate v0 with constant acceleration a, t = (sqrt(v0^2 + 2as) - v0) / a
+static inline float time_at(float v0, float a, float s)
+{
+    return (sqrtf(v0 * v0 + 2.0f * a * s) - v0) / a;
+}
+
+uint32_t profile_ticks(const motion_profile_t *profile, uint32_t step, uint32_t timer_clock)
+{
+    float dt, remaining;
+
+    if(step < profile->accel_steps)
+    {
+        dt = time_at(profile->entry_rate, profile->acceleration, (float)(step + 1))
+           - time_at(profile->entry_rate, profile->acceleration, (float)step);
+    }
+    else if(step >= profile->steps - profile->decel_steps)
+    {
+        // Mirror of acceleration counted backwards from the end of the move
+        remaining = (float)(profile->steps - step);
+        dt = time_at(profile->exit_rate, profile->acceleration, remaining)
+           - time_at(profile->exit_rate, profile->acceleration, remaining - 1.0f);
+    }
+    else
+        dt = 1.0f / profile->cruise_rate;
+
+    // Rounded, a truncated cruise period gains most of a tick on every step
+    dt = dt * (float)timer_clock + 0.5f;
+
+    return dt >= (float)UINT32_MAX ? UINT32_MAX : (uint32_t)dt;
+}
+
+float profile_time(const motion_profile_t *profile, uint32_t step)
+{
+    uint32_t cruise_end = profile->steps - profile->decel_steps;
+    float t;
+
+    if(step <= profile->accel_steps)
+        return time_at(profile->entry_rate, profile->acceleration, (float)step);
+
+    t = time_at(profile->entry_rate, profile->acceleration, (float)profile->accel_steps);
+    if(step <= cruise_end)
+        return t + (float)(step - profile->accel_steps) / profile->cruise_rate;
+
+    return t + (float)(cruise_end - profile->accel_steps) / profile->cruise_rate
+             + time_at(profile->exit_rate, profile->acceleration, (float)profile->decel_steps)
+             - time_at(profile->exit_rate, profile->acceleration, (float)(profile->steps - step));
+}
+
+float profile_position(const motion_profile_t *profile, float time)
+{
+    uint32_t cruise_end = profile->steps - profile->decel_steps;
+    float accel_end, decel_start, t;
+
+    if(time <= 0.0f || profile->steps == 0)
+        return 0.0f;
+
+    accel_end = time_at(profile->entry_rate, profile->acceleration, (float)profile->accel_steps);
+    if(time < accel_end)
+        return (profile->entry_rate + profile->acceleration * time * 0.5f) * time;
+
+    decel_start = accel_end + (float)(cruise_end - profile->accel_steps) / profile->cruise_rate;
+    if(time < decel_start)
+        return (float)profile->accel_steps + (time - accel_end) * profile->cruise_rate;
+
+    // Mirror of acceleration counted backwards from the end of the move
+    t = decel_start + time_at(profile->exit_rate, profile->acceleration, (float)profile->decel_steps) - time;
+    if(t <= 0.0f)
+        return (float)profile->steps;
+
+    return (float)profile->steps - (profile->exit_rate + profile->acceleration * t * 0.5f) * t;
+}
+
+// Jerk of each S-curve phase in units of the profile jerk
+static const int8_t scurve_jerk_sign[7] = { 1, 0, -1, 0, -1, 0, 1 };
+
+void scurve_calculate(scurve_profile_t *profile, uint32_t steps, float cruise_rate, float acceleration, float jerk)
+{
+    float distance = (float)steps, duration[7], elapsed, t, j;
+    uint_fast8_t phase;
+
+    // Peak acceleration is only reached if the rate change takes longer than the jerk ramps
+    if(cruise_rate * jerk < acceleration * acceleration)
+        acceleration = sqrtf(cruise_rate * jerk);
+
+    // Distance to get up to cruise and back down, each ramp takes v * (v / a + a / j) / 2
+    if(cruise_rate * (cruise_rate / acceleration + acceleration / jerk) > distance)
+    {
+        // Too short to cruise, first try with full acceleration: v^2 + v a^2 / j - a d = 0
+        cruise_rate = (sqrtf(acceleration * acceleration * acceleration * acceleration / (jerk * jerk)
+                             + 4.0f * acceleration * distance) - acceleration * acceleration / jerk) * 0.5f;
+        if(cruise_rate * jerk < acceleration * acceleration)
+        {
+            // Acceleration only ramps up and down: d / 2 = v * sqrt(v / j)
+            cruise_rate = cbrtf(distance * distance * jerk * 0.25f);
+            acceleration = sqrtf(cruise_rate * jerk);
+        }
+    }
+
+    profile->steps = steps;
+    profile->cruise_rate = cruise_rate;
+    profile->acceleration = acceleration;
+    profile->jerk = jerk;
+
+    duration[0] = duration[2] = duration[4] = duration[6] = steps ? acceleration / jerk : 0.0f;
+    duration[1] = duration[5] = steps ? fmaxf(cruise_rate / acceleration - acceleration / jerk, 0.0f) : 0.0f;
+    duration[3] = steps ? fmaxf(distance / cruise_rate - cruise_rate / acceleration - acceleration / jerk, 0.0f) : 0.0f;
+
+    profile->position[0] = profile->rate[0] = profile->accel[0] = elapsed = 0.0f;
+    for(phase = 0; phase < 7; phase++)
+    {
+        t = duration[phase];
+        profile->end[phase] = elapsed += t;
+        if(phase < 6)
+        {
+            j = scurve_jerk_sign[phase] * jerk;
+            profile->position[phase + 1] = profile->position[phase] + profile->rate[phase] * t
+                                         + profile->accel[phase] * t * t * 0.5f + j * t * t * t / 6.0f;
+            profile->rate[phase + 1] = profile->rate[phase] + profile->accel[phase] * t + j * t * t * 0.5f;
+            profile->accel[phase + 1] = profile->accel[phase] + j * t;
+        }
+    }
+}
+
+float scurve_time(const scurve_profile_t *profile, uint32_t step)
+{
+    float s = (float)step, start, length, t, lo, hi, f, df, j;
+    uint_fast8_t phase, i;
+
+    if(step == 0)
+        return 0.0f;
+    if(step >= profile->steps)
+        return profile->end[6];
+
+    for(phase = 0; phase < 6 && profile->position[phase + 1] <= s; phase++);
+
+    start = phase ? profile->end[phase - 1] : 0.0f;
+    length = profile->end[phase] - start;
+    j = scurve_jerk_sign[phase] * profile->jerk;
+    s -= profile->position[phase];
+
+    // Position is monotonic within the phase, Newton's method kept inside a bisection bracket
+    lo = 0.0f;
+    hi = length;
+    t = phase == 0 ? cbrtf(6.0f * s / profile->jerk) : length * 0.5f;
+    for(i = 0; i < 30; i++)
+    {
+        f = ((j * t / 6.0f + profile->accel[phase] * 0.5f) * t + profile->rate[phase]) * t - s;
+        if(fabsf(f) < 1e-4f)
+            break;
+        if(f > 0.0f)
+            hi = t;
+        else
+            lo = t;
+        df = (j * t * 0.5f + profile->accel[phase]) * t + profile->rate[phase];
+        t = df > 0.0f ? t - f / df : lo;
+        if(!(t > lo && t < hi))
+            t = (lo + hi) * 0.5f;
+    }
+
+    return start + t;
+}
+
+uint32_t scurve_segment(const scurve_profile_t *profile, uint32_t step, uint32_t segment_ticks, uint32_t timer_clock, uint32_t *ticks)
+{
+    float start = scurve_time(profile, step), period;
+    uint32_t n, left = profile->steps - step;
+
+    // Steps fitting in the segment at the rate of the first one
+    period = (scurve_time(profile, step + 1) - start) * (float)timer_clock;
+    n = period >= (float)segment_ticks ? 1 : (uint32_t)((float)segment_ticks / period);
+    if(n > left)
+        n = left;
+
+    period = (scurve_time(profile, step + n) - start) * (float)timer_clock / (float)n;
+    *ticks = period >= (float)UINT32_MAX ? UINT32_MAX : (uint32_t)lroundf(period);
+
+    return n;
+}
+
+float scurve_position(const scurve_profile_t *profile, float time)
+{
+    float t, j;
+    uint_fast8_t phase;
+
+    if(time <= 0.0f)
+        return 0.0f;
+    if(time >= profile->end[6])
+        return (float)profile->steps;
+
+    for(phase = 0; phase < 6 && profile->end[phase] <= time; phase++);
+
+    t = time - (phase ? profile->end[phase - 1] : 0.0f);
+    j = scurve_jerk_sign[phase] * profile->jerk;
+
+    return ((j * t / 6.0f + profile->accel[phase] * 0.5f) * t + profile->rate[phase]) * t + profile->position[phase];
+}
@@ -0,0 +1,75 @@
+/*
+ * motion_profile.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Trapezoidal velocity profile in step space. A move of n steps accelerates from the entry
+ *  rate to the cruise rate, cruises, and decelerates to the exit rate. Moves too short to
+ *  reach cruise become triangles with the peak rate where acceleration and deceleration meet.
+ *  The jerk limited S-curve profile ramps acceleration up and down as well, it runs from rest
+ *  to rest and is used for point to point moves of axes with a jerk setting.
+ *  Free of RTOS dependencies so it can be built on the host.
+ */
+
+#ifndef GCODE_MOTION_PROFILE_H_
+#define GCODE_MOTION_PROFILE_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t steps;         // Total steps in move
+    uint32_t accel_steps;   // Steps spent accelerating from entry_rate
+    uint32_t decel_steps;   // Steps spent decelerating to exit_rate
+    float entry_rate;       // steps/sec
+    float cruise_rate;      // steps/sec, peak rate for triangle profiles
+    float exit_rate;        // steps/sec
+    float acceleration;     // steps/sec^2
+} motion_profile_t;
+
+// Jerk limited profile from rest to rest in 7 phases: jerk up, constant acceleration, jerk down,
+// cruise, and the same mirrored down to rest. Phases a short move does not need are zero long.
+typedef struct {
+    uint32_t steps;         // Total steps in move
+    float cruise_rate;      // steps/sec, peak rate reached
+    float acceleration;     // steps/sec^2, peak acceleration reached
+    float jerk;             // steps/sec^3
+    float end[7];           // Phase end times, sec from start
+    float position[7];      // State at the start of each phase, steps
+    float rate[7];          // steps/sec
+    float accel[7];         // steps/sec^2
+} scurve_profile_t;
+
+// Plan profile for a move. Rates are clamped so entry and exit never exceed cruise.
+void profile_calculate(motion_profile_t *profile, uint32_t steps, float entry_rate, float cruise_rate, float exit_rate, float acceleration);
+
+// Timer ticks between step and step + 1, step 0 is the delay before the first step.
+uint32_t profile_ticks(const motion_profile_t *profile, uint32_t step, uint32_t timer_clock);
+
+// Seconds from the start of the move to step, step 0 is the start.
+float profile_time(const motion_profile_t *profile, uint32_t step);
+
+// Plan S-curve profile for a move, rate and acceleration are lowered if the move is too short
+// to reach them.
+void scurve_calculate(scurve_profile_t *profile, uint32_t steps, float cruise_rate, float acceleration, float jerk);
+
+// Seconds from the start of the move to step, step 0 is the start.
+float scurve_time(const scurve_profile_t *profile, uint32_t step);
+
+// Steps from step on to run at one constant period for about segment_ticks, the period is
+// returned in ticks. The segment ends on the exact time of its last step.
+uint32_t scurve_segment(const scurve_profile_t *profile, uint32_t step, uint32_t segment_ticks, uint32_t timer_clock, uint32_t *ticks);
+
+// Steps moved at time, in seconds from the start of the move.
+float scurve_position(const scurve_profile_t *profile, float time);
+
+// Steps moved at time, in seconds from the start of the move.
+float profile_position(const motion_profile_t *profile, float time);
+
+// Number of steps at cruise rate.
+static inline uint32_t profile_cruise_steps(const motion_profile_t *profile)
+{
+    return profile->steps - profile->accel_steps - profile->decel_steps;
+}
+
+#endif /* GCODE_MOTION_PROFILE_H_ */
@@ -6,91 +6,276 @@
  */
 
 #include "PnPContoller_Main.h"
-#include "circular_buffer.h"
-
-#include "fsl_pit.h"
-#include "fsl_clock.h"
-#include "fsl_gpio.h"
-
-/*******************************************************************************
- * Definitions
- ******************************************************************************/
-/* PIT clock = 66MHz */
-#define PIT_IRQ_HANDLER 			PIT_IRQHandler
-#define PIT_IRQ_ID 					PIT_IRQn
-#define PIT_SOURCE_CLOCK 			CLOCK_GetFreq(kCLOCK_PerClk)
-
-
-#define AXIS_BUFFER_SIZE 10000
-#define START_CRUISE_VALUE 999999
 
 /*******************************************************************************
  * Variables
  ******************************************************************************/
 
+// Look-ahead ring. Blocks from tail to head are waiting for the stepper, entry speeds from
+// tail up to and including block_buffer_planned are final and never recalculated.
+static HOT_DATA plan_block_t block_buffer[BLOCK_BUFFER_SIZE];
+static HOT_DATA uint_fast8_t block_buffer_tail;     // Next block for the stepper
+static HOT_DATA uint_fast8_t block_buffer_head;     // Next free slot
+static uint_fast8_t next_buffer_head;      // Slot after head, equal to tail when full
+static uint_fast8_t block_buffer_planned;  // First block that may still be replanned
+
+// Planner thread, blocks on its task notification while the ring is full
+static TaskHandle_t planner_task;
+
+// Planner state for the junction to the next block
+static struct {
+    int32_t position[N_AXIS];       // Planned position in steps
+    float previous_unit_vec[N_AXIS];
+    float previous_nominal_speed;
+} pl;
+
+static inline uint_fast8_t plan_next_block_index(uint_fast8_t block_index)
+{
+    return ++block_index == BLOCK_BUFFER_SIZE ? 0 : block_index;
+}
 
-pit_config_t pitConfig;
-
-uint32_t * Axis_X_buffer;
-uint32_t * Axis_Y_buffer;
-axis_t Axis_X;
-axis_t Axis_Y;
+static inline uint_fast8_t plan_prev_block_index(uint_fast8_t block_index)
+{
+    return (block_index == 0 ? BLOCK_BUFFER_SIZE : block_index) - 1;
+}
 
-/*******************************************************************************
- * SDRAM
- ******************************************************************************/
+/*                            PLANNER SPEED DEFINITION
+                                     +--------+   <- current->nominal_speed
+                                    /          \
+         current->entry_speed ->   +            \
+                                   |             + <- next->entry_speed (aka exit speed)
+                                   +-------------+
+                                       time -->
+
+  Recalculates the entry speeds of the blocks after block_buffer_planned. The reverse pass
+  lowers entry speeds so every block can decelerate to the entry of the next, ending at zero
+  speed after the newest block. The forward pass lowers them again where a block cannot
+  accelerate to the entry of the next. A block whose entry speed is at its maximum, or that
+  is reached by full acceleration from the planned pointer, can never improve and moves
+  block_buffer_planned forward, so only the blocks that changed are visited next time.
+*/
+static void planner_recalculate(void)
+{
+    uint_fast8_t block_index = plan_prev_block_index(block_buffer_head);
+    plan_block_t *current, *next;
+    float entry_speed_sqr;
+
+    // Only one block that may change, it has a fixed entry speed
+    if(block_index == block_buffer_planned)
+        return;
+
+    // Newest block always ends at zero speed
+    current = &block_buffer[block_index];
+    current->entry_speed_sqr = min(current->max_entry_speed_sqr, 2.0f * current->acceleration * current->millimeters);
+
+    // Reverse pass
+    block_index = plan_prev_block_index(block_index);
+    while(block_index != block_buffer_planned)
+    {
+        next = current;
+        current = &block_buffer[block_index];
+        block_index = plan_prev_block_index(block_index);
+
+        if(current->entry_speed_sqr != current->max_entry_speed_sqr)
+        {
+            entry_speed_sqr = next->entry_speed_sqr + 2.0f * current->acceleration * current->millimeters;
+            current->entry_speed_sqr = min(entry_speed_sqr, current->max_entry_speed_sqr);
+        }
+    }
+
+    // Forward pass
+    next = &block_buffer[block_buffer_planned];
+    block_index = plan_next_block_index(block_buffer_planned);
+    while(block_index != block_buffer_head)
+    {
+        current = next;
+        next = &block_buffer[block_index];
+
+        // Acceleration limited, next entry is optimal and can move the planned pointer
+        if(current->entry_speed_sqr < next->entry_speed_sqr)
+        {
+            entry_speed_sqr = current->entry_speed_sqr + 2.0f * current->acceleration * current->millimeters;
+            if(entry_speed_sqr < next->entry_speed_sqr)
+            {
+                next->entry_speed_sqr = entry_speed_sqr;
+                block_buffer_planned = block_index;
+            }
+        }
+
+        if(next->entry_speed_sqr == next->max_entry_speed_sqr)
+            block_buffer_planned = block_index;
+
+        block_index = plan_next_block_index(block_index);
+    }
+}
 
-cbuf_handle_t cbufX;
-cbuf_handle_t cbufY;
+void plan_reset(void)
+{
+    memset(&pl, 0, sizeof(pl));
+    block_buffer_tail = 0;
+    block_buffer_head = 0;
+    next_buffer_head = 1;
+    block_buffer_planned = 0;
+}
 
+bool plan_check_full_buffer(void)
+{
+    return block_buffer_tail == next_buffer_head;
+}
 
+// Block the stepper should execute next, NULL if the ring is empty
+plan_block_t *plan_get_current_block(void)
+{
+    return block_buffer_head == block_buffer_tail ? NULL : &block_buffer[block_buffer_tail];
+}
 
-//
-// Timer clock ticks at 66 MHz
-//
+bool plan_has_next_block(void)
+{
+    return block_buffer_head != block_buffer_tail && plan_next_block_index(block_buffer_tail) != block_buffer_head;
+}
 
-void HandlePIT_IRQ(pit_chnl_t c, cbuf_handle_t cbuf, axis_t * axis)
+// Exit speed for the current block. The stepper commits to it, so the entry speed of the
+// following block is frozen by moving the planned pointer past the current block.
+float plan_get_exec_block_exit_speed_sqr(void)
 {
+    uint_fast8_t block_index = plan_next_block_index(block_buffer_tail);
 
-	uint32_t data;	// Data in buffer
-	bool x;
+    if(block_index == block_buffer_head)
+        return 0.0f;
 
-	// Check if channel has caused the interrupt
-	if(PIT_GetStatusFlags(PIT, c) == 1)
-	{
-		// Disable timer and set move as ready if target reached
-		if(axis->ActualPos == axis->TargetPos)
-		{
-			PIT_StopTimer(PIT, c);
-			printf("StopTimer\r\n");
-			circular_buf_reset(cbuf);
-			axis->moveReady = true;
-		}
-		else
-		{
-			GPIO_PinWrite(axis->GPIO, axis->StepPin, 1U);
-			axis->ActualPos ++;
+    if(block_buffer_planned == block_buffer_tail)
+        block_buffer_planned = block_index;
 
-			// Set new value for step time
-			// We are using same as previous if nothing in queue
-			if(circular_buf_get(cbuf, &data)==0)
-			{
-				PIT_SetTimerPeriod(PIT, c, data);
-			}
+    return block_buffer[block_index].entry_speed_sqr;
+}
 
-			GPIO_PinWrite(axis->GPIO, axis->StepPin, 0U);
-		}
+void plan_discard_current_block(void)
+{
+    if(block_buffer_head != block_buffer_tail)
+    {
+        uint_fast8_t block_index = plan_next_block_index(block_buffer_tail);
 
-		// Clear interrupt
-		PIT_ClearStatusFlags(PIT, c, kPIT_TimerFlag);
+        if(block_buffer_tail == block_buffer_planned)
+            block_buffer_planned = block_index;
 
-	}
+        block_buffer_tail = block_index;
+    }
 }
 
-void PIT_IRQ_HANDLER(void)
+void plan_wake(void)
 {
-	HandlePIT_IRQ(kPIT_Chnl_0, cbufX, &Axis_X);
-	HandlePIT_IRQ(kPIT_Chnl_1, cbufY, &Axis_Y);
+    if(planner_task)
+        xTaskNotifyGive(planner_task);
+}
+
+// Add a linear move to the ring and replan. Target is in mm, feed rate in mm/min.
+// Returns false for moves too short to produce a step, they are dropped.
+// The caller must check plan_check_full_buffer() first.
+bool plan_buffer_line(float *target, plan_line_data_t *pl_data)
+{
+    PROBE_SCOPE(Probe_PlanBufferLine);
+    plan_block_t *block = &block_buffer[block_buffer_head];
+    int32_t target_steps[N_AXIS];
+    float unit_vec[N_AXIS] = {0}, junction_unit_vec[N_AXIS] = {0}, max_rate[N_AXIS], acceleration[N_AXIS];
+    float junction_cos_theta, sin_theta_d2, junction_acceleration, nominal_speed, distance;
+    output_command_t *command;
+    uint_fast8_t idx, n;
+    int32_t step;
+
+    memset(block, 0, sizeof(plan_block_t));
+    block->condition = pl_data->condition;
+
+    for(idx = 0; idx < N_BASE_AXIS; idx++)
+    {
+        target_steps[idx] = lroundf(target[idx] * settings.axis[idx].steps_per_mm);
+        block->steps[idx] = target_steps[idx] - pl.position[idx];
+        block->step_event_count = max(block->step_event_count, (uint32_t)labs(block->steps[idx]));
+        unit_vec[idx] = (float)block->steps[idx] / settings.axis[idx].steps_per_mm;
+        max_rate[idx] = settings.axis[idx].max_rate / 60.0f;
+        acceleration[idx] = settings.axis[idx].acceleration;
+    }
+
+    if(block->step_event_count == 0)
+        return false;
+
+    block->millimeters = convert_delta_vector_to_unit_vector(unit_vec);
+
+    // Outputs switch with the step event nearest to their distance along the path
+    for(idx = 0; idx < pl_data->n_output_commands; idx++)
+    {
+        command = &pl_data->output_commands[idx];
+        if(!plan_output_on_base(command))
+            continue;
+
+        distance = command->distance < 0.0f ? block->millimeters + command->distance : command->distance;
+        step = lroundf(distance / block->millimeters * (float)block->step_event_count);
+        step = min(max(step, 0), (int32_t)block->step_event_count - 1);
+
+        for(n = block->n_outputs++; n > 0 && block->outputs[n - 1].step > (uint32_t)step; n--)
+            block->outputs[n] = block->outputs[n - 1];
+        block->outputs[n].step = step;
+        block->outputs[n].port = command->port;
+        block->outputs[n].value = command->value != 0;
+    }
+
+    // The axes of an async rapid share no step events to switch outputs with
+    if(block->n_outputs)
+        block->condition.async_motion = false;
+
+    // Rapids run at the axis max rates, feed moves are limited by them
+    block->acceleration = limit_value_by_axis_maximum(acceleration, unit_vec);
+    nominal_speed = limit_value_by_axis_maximum(max_rate, unit_vec);
+    if(!block->condition.rapid_motion)
+        nominal_speed = min(nominal_speed, pl_data->feed_rate / 60.0f);
+    block->nominal_speed_sqr = nominal_speed * nominal_speed;
+
+    // Asynchronous rapids run every axis on its own profile, they start and end at rest
+    if(block->condition.async_motion)
+        nominal_speed = 0.0f;
+
+    // Junction speed from the deviation of a virtual arc tangent to both moves, see
+    // https://onehossshay.wordpress.com/2011/09/24/improving_grbl_cornering_algorithm/
+    // An empty ring means the previous move is planned to stop.
+    if(block_buffer_head == block_buffer_tail || block->condition.async_motion)
+        block->max_entry_speed_sqr = 0.0f;
+    else
+    {
+        junction_cos_theta = 0.0f;
+        for(idx = 0; idx < N_BASE_AXIS; idx++)
+        {
+            junction_cos_theta -= pl.previous_unit_vec[idx] * unit_vec[idx];
+            junction_unit_vec[idx] = unit_vec[idx] - pl.previous_unit_vec[idx];
+        }
+
+        if(junction_cos_theta > 0.999999f)
+            // Full reversal
+            block->max_entry_speed_sqr = MINIMUM_JUNCTION_SPEED * MINIMUM_JUNCTION_SPEED;
+        else if(junction_cos_theta < -0.999999f)
+            // Straight line, limited by the nominal speeds only
+            block->max_entry_speed_sqr = SOME_LARGE_VALUE;
+        else
+        {
+            convert_delta_vector_to_unit_vector(junction_unit_vec);
+            junction_acceleration = limit_value_by_axis_maximum(acceleration, junction_unit_vec);
+            sin_theta_d2 = sqrtf(0.5f * (1.0f - junction_cos_theta));
+            block->max_entry_speed_sqr = max(MINIMUM_JUNCTION_SPEED * MINIMUM_JUNCTION_SPEED,
+                                             (junction_acceleration * settings.junction_deviation * sin_theta_d2) / (1.0f - sin_theta_d2));
+        }
+
+        block->max_entry_speed_sqr = min(block->max_entry_speed_sqr,
+                                         min(block->nominal_speed_sqr, pl.previous_nominal_speed * pl.previous_nominal_speed));
+    }
+
+    memcpy(pl.previous_unit_vec, unit_vec, sizeof(unit_vec));
+    pl.previous_nominal_speed = nominal_speed;
+    memcpy(pl.position, target_steps, sizeof(int32_t) * N_BASE_AXIS);
+
+    block_buffer_head = next_buffer_head;
+    next_buffer_head = plan_next_block_index(block_buffer_head);
+
+    planner_recalculate();
+
+    return true;
 }
 
 //
@@ -102,111 +287,172 @@ void submitMoveHead(parser_block_t *block, char *message)
 
 //
 // Submit move on Base controller
+// Waits for a free slot in the look-ahead ring, the move then blends with the moves around it.
 void submitMoveBase(parser_block_t *block, char *message)
 {
+	PROBE_SCOPE(Probe_SubmitMoveBase);
+	plan_line_data_t plan_data;
+	uint_fast8_t idx;
+	bool queued;
+
+	memset(&plan_data, 0, sizeof(plan_line_data_t));
+	plan_data.feed_rate = block->values.f;
+	plan_data.condition.rapid_motion = block->modal.motion == MotionMode_Seek;
+	plan_data.condition.async_motion = plan_data.condition.rapid_motion && settings.async_rapids;
+	plan_data.line_number = block->values.n;
+	plan_data.message = message;
+	plan_data.output_commands = block->output_commands;
+	plan_data.n_output_commands = block->n_output_commands;
+
+	// The stepper thread gives the notification when it takes a block
+	while(plan_check_full_buffer())
+	{
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	}
 
-	uint32_t ticksForStep, i;
-	BaseController.MoveReady = false;
-	Axis_X.moveReady = false;
-	Axis_Y.moveReady = true;
+	// Counted first, the ISR finishing the moves before cannot set the bits again once cleared.
+	// Cleared before the block is visible, the ISR may finish a short one right away.
+	stepper_move_submitted();
+	xEventGroupClearBits(xMoveReady, BaseController.ReadyBit | MOVE_READY_BASE_AXES);
 
-	//Loop throu all segments in move and add to ring buffer
-	// Min=3us = 198, 2us = 132
-	// Min time for routine is 350 ->
-	ticksForStep = USEC_TO_COUNT(2, PIT_SOURCE_CLOCK);
-	//circular_buf_put(cbufX, 0U);
+	vTaskSuspendAll();
+	queued = plan_buffer_line(block->values.xyz, &plan_data);
+	xTaskResumeAll();
 
-	Axis_X.TargetPos += 250000;
-	// Accelerate
-	for(i=0; i<5000; i++)
+	if(queued)
+		stepper_wake();
+	else
 	{
-		while(circular_buf_full(cbufX))
-		{
-			vTaskDelay(1);
-		}
-		//ticksForStep = 300 + 5000 -(block->values.xyz[0] * 2500);
-		ticksForStep = 300 + 5000 - i;
-		if(i==0)
-		{
-			/* Set timer period and start timer for first segment */
-			PIT_SetTimerPeriod(PIT, kPIT_Chnl_0, ticksForStep);
-			PIT_SetTimerPeriod(PIT, kPIT_Chnl_1, ticksForStep);
-			PIT_StartTimer(PIT, kPIT_Chnl_0);
-		}
-		else
+		stepper_move_dropped();
+		AxisReady();
+
+		// Nothing to step, outputs switch once the moves before are done
+		for(idx = 0; idx < block->n_output_commands; idx++)
 		{
-			circular_buf_put(cbufX, ticksForStep);
+			if(plan_output_on_base(&block->output_commands[idx]))
+			{
+				stepper_flush();
+				xEventGroupWaitBits(xMoveReady, BaseController.ReadyBit, pdFALSE, pdTRUE, portMAX_DELAY);
+				stepper_set_output(block->output_commands[idx].port, block->output_commands[idx].value != 0);
+			}
 		}
 	}
-	// Cruise
-	Axis_X.CruiseStepsLeft = 240000;
-	Axis_X.Cruising = true;
-	circular_buf_put(cbufX, START_CRUISE_VALUE);
+}
+
+// Resources a block holds until the controllers it was sent to report ready
+#define RESOURCE_GANTRY		bit(0)		// X and Y on the base
+#define RESOURCE_NOZZLE		bit(1)		// Z, U and the head outputs, the nozzle going up and down
+#define RESOURCE_ROTATION	bit(2)		// A to D on the head
+#define RESOURCE_FEEDER1	bit(3)
+#define RESOURCE_FEEDER2	bit(4)
+#define RESOURCE_ALL		(bit(5) - 1)
+
+// Resources that must be at rest before a resource is dispatched, indexed by resource bit.
+// The nozzle only goes down with the gantry and the feeders stopped and the rotation done,
+// the gantry only travels with the nozzle up. Feeders index and nozzles rotate while the
+// gantry travels. The base streams its own moves through the look-ahead ring, the other
+// controllers take one move at a time.
+static const uint8_t resource_conflicts[] = {
+	RESOURCE_NOZZLE,							// Gantry
+	RESOURCE_ALL,								// Nozzle
+	RESOURCE_NOZZLE | RESOURCE_ROTATION,		// Rotation
+	RESOURCE_NOZZLE | RESOURCE_FEEDER1,			// Feeder 1
+	RESOURCE_NOZZLE | RESOURCE_FEEDER2			// Feeder 2
+};
+
+// Controllers in dispatch order with the resources they drive
+static controllerBoard_t * const controllers[] = {
+	&BaseController, &HeadController, &Feeder1Controller, &Feeder2Controller
+};
+static const uint8_t controller_resources[] = {
+	RESOURCE_GANTRY, RESOURCE_NOZZLE | RESOURCE_ROTATION, RESOURCE_FEEDER1, RESOURCE_FEEDER2
+};
+
+// Resources sent to each controller since it was last seen ready
+static uint8_t controller_busy[sizeof(controllers) / sizeof(controllers[0])];
+
+//
+// Resources used by a block, from its axis words and the controllers of its outputs
+static uint_fast8_t block_resources(parser_block_t *block)
+{
+	uint_fast8_t resources = 0;
+
+	if(block->axis_words & (X_AXIS_BIT | Y_AXIS_BIT))
+		resources |= RESOURCE_GANTRY;
+	if(block->axis_words & (Z_AXIS_BIT | U_AXIS_BIT))
+		resources |= RESOURCE_NOZZLE;
+	if(block->axis_words & (A_AXIS_BIT | B_AXIS_BIT | C_AXIS_BIT | D_AXIS_BIT))
+		resources |= RESOURCE_ROTATION;
+	if(block->controlers.Ctrl_Base && !(resources & RESOURCE_GANTRY))
+		resources |= RESOURCE_GANTRY;
+	if(block->controlers.Ctrl_Head && !(resources & (RESOURCE_NOZZLE | RESOURCE_ROTATION)))
+		resources |= RESOURCE_NOZZLE;
+	if(block->controlers.Ctrl_Feeder1)
+		resources |= RESOURCE_FEEDER1;
+	if(block->controlers.Ctrl_Feeder2)
+		resources |= RESOURCE_FEEDER2;
+
+	return resources;
+}
+
+//
+// Wait until no busy controller holds a resource that conflicts with resources
+static void schedule_wait(uint_fast8_t resources)
+{
+	uint_fast8_t idx, conflicts = 0;
+	EventBits_t ready, wait = 0;
+
+	for(idx = 0; idx < sizeof(resource_conflicts); idx++)
+	{
+		if(resources & bit(idx))
+			conflicts |= resource_conflicts[idx];
+	}
 
-	// Decelerate
-	for(i=0; i<5000; i++)
+	ready = xEventGroupGetBits(xMoveReady);
+	for(idx = 0; idx < sizeof(controller_busy); idx++)
 	{
-		while(circular_buf_full(cbufX))
+		if(ready & controllers[idx]->ReadyBit)
+			controller_busy[idx] = 0;
+		else if(controller_busy[idx] & conflicts)
+			wait |= controllers[idx]->ReadyBit;
+	}
+
+	if(wait)
+	{
+		stepper_flush();
+		xEventGroupWaitBits(xMoveReady, wait, pdFALSE, pdTRUE, portMAX_DELAY);
+		for(idx = 0; idx < sizeof(controller_busy); idx++)
 		{
-			vTaskDelay(1);
+			if(wait & controllers[idx]->ReadyBit)
+				controller_busy[idx] = 0;
 		}
-		ticksForStep = 300 + i;
-		circular_buf_put(cbufX, ticksForStep);
 	}
 }
 
-void AxisReady(void)
+//
+// Wait until every controller and base axis is done, M400
+static void schedule_sync(void)
 {
-	if(Axis_X.moveReady && Axis_Y.moveReady) BaseController.MoveReady = true;
+	stepper_flush();
+	xEventGroupWaitBits(xMoveReady, MOVE_READY_ALL, pdFALSE, pdTRUE, portMAX_DELAY);
+	memset(controller_busy, 0, sizeof(controller_busy));
 }
+
+// Dispatches blocks in order, each as soon as the resources it conflicts with are at rest.
+// A block does not wait for controllers it has nothing to do with, so feeders index and
+// the nozzles rotate while the gantry travels.
 static void planner_thread(void *arg)
 {
 	extern QueueHandle_t xPlannerQueue;
 	parser_block_t inbuff;
 	char message[50];
 //	char xinbuff[50];
+	uint_fast8_t idx, resources;
 
+	plan_reset();
+	planner_task = xTaskGetCurrentTaskHandle();
 
-	// Init buffer för steppers
-#ifdef useSDRAM
-	Axis_X_buffer = (uint32_t *)EXAMPLE_SEMC_START_ADDRESS; /* SDRAM start address. */
-	Axis_Y_buffer = (uint32_t *)EXAMPLE_SEMC_START_ADDRESS + (AXIS_BUFFER_SIZE * sizeof(uint32_t));
-	cbufX = SDRAM_buf_init(AXIS_BUFFER_SIZE);
-	cbufY = SDRAM_buf_init(AXIS_BUFFER_SIZE);
-#else
-//	Axis_X_buffer  = malloc(AXIS_BUFFER_SIZE * sizeof(uint32_t));
-//	Axis_Y_buffer  = malloc(AXIS_BUFFER_SIZE * sizeof(uint32_t));
-
-	AT_NONCACHEABLE_SECTION_ALIGN(static uint32_t Axis_X_buffer[AXIS_BUFFER_SIZE], 64U);
-	AT_NONCACHEABLE_SECTION_ALIGN(static uint32_t Axis_Y_buffer[AXIS_BUFFER_SIZE], 64U);
-
-	cbufX = circular_buf_init(Axis_X_buffer, AXIS_BUFFER_SIZE);
-	cbufY = circular_buf_init(Axis_Y_buffer, AXIS_BUFFER_SIZE);
-#endif
-
-	// Init Axis
-	Axis_X.GPIO = GPIO1;
-	Axis_X.StepPin  = 18;
-	Axis_X.AxisNum = 1;
-	Axis_X.ActualPos = 0;
-	Axis_X.TargetPos = 0;
-	Axis_X.DirectionForward = true;
-
-	// Set up timer
-	PIT_GetDefaultConfig(&pitConfig);
-
-	/* Init pit module */
-	PIT_Init(PIT, &pitConfig);
-
-	PIT_EnableInterrupts(PIT, kPIT_Chnl_0,  kPIT_TimerInterruptEnable);
-	PIT_EnableInterrupts(PIT, kPIT_Chnl_1,  kPIT_TimerInterruptEnable);
-
-	/* Enable at the NVIC */
-	EnableIRQ(PIT_IRQ_ID);
-
-	PRINTF("\r\n PIT_SOURCE_CLOCK is: %d \r\n", PIT_SOURCE_CLOCK);
-
-	xPlannerQueue = xQueueCreate(10, sizeof(parser_block_t));
+	xPlannerQueue = xQueueCreate(PLANNER_QUEUE_LENGTH, sizeof(parser_block_t));
 
 	if (xPlannerQueue == NULL)
 	{
@@ -217,9 +463,18 @@ static void planner_thread(void *arg)
 	{
 		for (;;)
 		{
+			// Nothing more to plan against, the stepper starts what it has without the start
+			// delay. The g-code thread runs above this one, it is waiting for input as well.
+			if (uxQueueMessagesWaiting(xPlannerQueue) == 0)
+				stepper_flush();
+
 			// Get new GCode line from GCode queue
 			if (xQueueReceive(xPlannerQueue, &inbuff, portMAX_DELAY) == pdPASS)
 			{
+				resources = block_resources(&inbuff);
+				if(resources)
+					schedule_wait(resources);
+
 				// Send command to involved controllers
 				if (inbuff.controlers.Ctrl_Feeder2)
 				{
@@ -235,21 +490,15 @@ static void planner_thread(void *arg)
 				}
 				if (inbuff.controlers.Ctrl_Base)
 				{
-					printf("start\r\n");
 					submitMoveBase(&inbuff, &message);
 				}
 
-				// Wait for all controllers to report ready
-				while (!BaseController.MoveReady
-						|| !HeadController.MoveReady
-						|| !Feeder1Controller.MoveReady
-						|| !Feeder2Controller.MoveReady)
-				{
-					vTaskDelay(1);
-					AxisReady();
-				}
+				for(idx = 0; idx < sizeof(controller_busy); idx++)
+					controller_busy[idx] |= resources & controller_resources[idx];
 
-				printf("klar\r\n");
+				// Sync point, nothing after it starts before everything up to it is done
+				if (inbuff.sync)
+					schedule_sync();
 			}
 		}
 	}
@@ -13,6 +13,15 @@
   #define BLOCK_BUFFER_SIZE 36
 #endif
 
+// Axes driven by the base controller, X and Y
+#define N_BASE_AXIS 2
+
+// Digital ports 0 to N_BASE_OUTPUTS - 1 are on the base controller
+#define N_BASE_OUTPUTS 50
+
+// Output commands switched by the step ISR, digital ports on the base controller
+#define plan_output_on_base(command) ((command)->is_digital && (command)->port < N_BASE_OUTPUTS)
+
 typedef union {
     uint32_t value;
     struct {
@@ -25,7 +34,8 @@ typedef union {
                  is_rpm_rate_adjusted :1,
                  is_rpm_pos_adjusted  :1,
                  is_laser_ppi_mode    :1,
-                 unassigned           :7;
+                 async_motion         :1,
+                 unassigned           :6;
     };
 } planner_cond_t;
 
@@ -39,9 +49,59 @@ typedef struct {
 //    void *parameters;               // TODO: pointer to extra parameters, for canned cycles and threading?
     char *message;                  // Message to be displayed when block is executed.
     output_command_t *output_commands;
+    uint8_t n_output_commands;
 } plan_line_data_t;
 
+// Base output switched by the step ISR together with a step event of the block
+typedef struct {
+    uint32_t step;                  // Step event of the dominant axis, from 0
+    uint8_t port;
+    uint8_t value;
+} plan_output_t;
+
+// Block in the look-ahead ring. Speeds are in mm/sec along the path.
+typedef struct {
+    int32_t steps[N_AXIS];          // Signed step count per axis
+    uint32_t step_event_count;      // Steps of the axis moving the most
+    float millimeters;              // Path length
+    float acceleration;             // mm/sec^2, limited so no axis exceeds its setting
+    float entry_speed_sqr;          // Planned entry speed
+    float max_entry_speed_sqr;      // Limit from the junction and nominal speeds
+    float nominal_speed_sqr;        // Feed rate or rapid rate
+    planner_cond_t condition;
+    uint8_t n_outputs;
+    plan_output_t outputs[GC_MAX_OUTPUTS];  // In step order
+} plan_block_t;
+
 
 void timer_init();
 
+// Reset the look-ahead ring and planned position
+void plan_reset(void);
+
+// Add a move to the look-ahead ring and replan, false if it is too short to step
+bool plan_buffer_line(float *target, plan_line_data_t *pl_data);
+
+// True when no block can be added
+bool plan_check_full_buffer(void);
+
+// Oldest block, the one the stepper executes next
+plan_block_t *plan_get_current_block(void);
+
+// True when a block follows the current one, its exit speed is planned against it
+bool plan_has_next_block(void);
+
+// Exit speed of the current block, freezes the entry speed of the following block
+float plan_get_exec_block_exit_speed_sqr(void);
+
+// Remove the current block from the ring
+void plan_discard_current_block(void);
+
+// Wakes the planner thread after a block has been taken, it may be waiting for a free slot
+void plan_wake(void);
+
+void planner_init(void);
+void submitMoveBase(parser_block_t *block, char *message);
+void submitMoveHead(parser_block_t *block, char *message);
+
 #endif /* GCODE_PLANNER_H_ */
@@ -0,0 +1,55 @@
+/*
+ * protocol.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include "PnPContoller_Main.h"
+
+bool protocol_enqueue_realtime_command(char c)
+{
+    int_fast16_t feed_rate = sys.override.feed_rate;
+
+    switch((uint8_t)c) {
+
+        case CMD_FEED_HOLD_LEGACY:
+            stepper_feed_hold();
+            return true;
+
+        case CMD_CYCLE_START_LEGACY:
+            stepper_cycle_start();
+            return true;
+
+        case CMD_OVERRIDE_FEED_RESET:
+            feed_rate = DEFAULT_FEED_OVERRIDE;
+            break;
+
+        case CMD_OVERRIDE_FEED_COARSE_PLUS:
+            feed_rate += FEED_OVERRIDE_COARSE_INCREMENT;
+            break;
+
+        case CMD_OVERRIDE_FEED_COARSE_MINUS:
+            feed_rate -= FEED_OVERRIDE_COARSE_INCREMENT;
+            break;
+
+        case CMD_OVERRIDE_FEED_FINE_PLUS:
+            feed_rate += FEED_OVERRIDE_FINE_INCREMENT;
+            break;
+
+        case CMD_OVERRIDE_FEED_FINE_MINUS:
+            feed_rate -= FEED_OVERRIDE_FINE_INCREMENT;
+            break;
+
+        default:
+            return false;
+    }
+
+    feed_rate = min(max(feed_rate, MIN_FEED_RATE_OVERRIDE), MAX_FEED_RATE_OVERRIDE);
+    if(feed_rate != sys.override.feed_rate) {
+        sys.override.feed_rate = (uint8_t)feed_rate;
+        stepper_feed_override(sys.override.feed_rate);
+    }
+
+    return true;
+}
@@ -0,0 +1,16 @@
+/*
+ * protocol.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#ifndef GCODE_PROTOCOL_H_
+#define GCODE_PROTOCOL_H_
+
+// Executes a realtime command picked off an input stream, see config.h. Returns false if c is
+// not one, it then stays in the stream. Feed hold, cycle start and the feed overrides act on
+// the step ISR at once, they do not wait for the lines queued before them.
+bool protocol_enqueue_realtime_command(char c);
+
+#endif /* GCODE_PROTOCOL_H_ */
@@ -15,5 +15,32 @@ const settings_t defaults = {
     .limits.flags.soft_enabled = DEFAULT_SOFT_LIMIT_ENABLE,
     .limits.flags.check_at_init = DEFAULT_CHECK_LIMITS_AT_INIT,
     .limits.invert.mask = INVERT_LIMIT_PIN_MASK,
-    .limits.disable_pullup.mask = DISABLE_LIMIT_PINS_PULL_UP_MASK
+    .limits.disable_pullup.mask = DISABLE_LIMIT_PINS_PULL_UP_MASK,
+
+    .junction_deviation = DEFAULT_JUNCTION_DEVIATION,
+    .async_rapids = DEFAULT_ASYNC_RAPIDS,
+    .underrun_response = DEFAULT_UNDERRUN_RESPONSE,
+
+    .axis[X_AXIS].steps_per_mm = DEFAULT_X_STEPS_PER_MM,
+    .axis[X_AXIS].max_rate = DEFAULT_X_MAX_RATE,
+    .axis[X_AXIS].acceleration = DEFAULT_X_ACCELERATION,
+    .axis[X_AXIS].jerk = DEFAULT_X_JERK,
+    .axis[X_AXIS].shaper = DEFAULT_X_SHAPER,
+    .axis[X_AXIS].shaper_frequency = DEFAULT_X_SHAPER_FREQUENCY,
+    .axis[X_AXIS].shaper_damping = DEFAULT_X_SHAPER_DAMPING,
+    .axis[Y_AXIS].steps_per_mm = DEFAULT_Y_STEPS_PER_MM,
+    .axis[Y_AXIS].max_rate = DEFAULT_Y_MAX_RATE,
+    .axis[Y_AXIS].acceleration = DEFAULT_Y_ACCELERATION,
+    .axis[Y_AXIS].jerk = DEFAULT_Y_JERK,
+    .axis[Y_AXIS].shaper = DEFAULT_Y_SHAPER,
+    .axis[Y_AXIS].shaper_frequency = DEFAULT_Y_SHAPER_FREQUENCY,
+    .axis[Y_AXIS].shaper_damping = DEFAULT_Y_SHAPER_DAMPING,
+    .axis[Z_AXIS].steps_per_mm = DEFAULT_Z_STEPS_PER_MM,
+    .axis[Z_AXIS].max_rate = DEFAULT_Z_MAX_RATE,
+    .axis[Z_AXIS].acceleration = DEFAULT_Z_ACCELERATION
 };
+
+void settings_init(void)
+{
+    memcpy(&settings, &defaults, sizeof(settings_t));
+}
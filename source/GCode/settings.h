@@ -62,10 +62,29 @@ typedef struct {
     axes_signals_t disable_pullup;
 } limit_settings_t;
 
+typedef struct {
+    float steps_per_mm;
+    float max_rate;         // mm/min
+    float acceleration;     // mm/sec^2
+    float jerk;             // mm/sec^3, S-curve point to point moves, 0 for trapezoidal
+    uint8_t shaper;         // shaper_type_t, input shaping of point to point moves
+    float shaper_frequency; // Hz, resonance the shaper cancels
+    float shaper_damping;   // Damping ratio of the resonance
+} axis_settings_t;
+
 // Global persistent settings (Stored from byte persistent storage_ADDR_GLOBAL onwards)
 typedef struct {
 	limit_settings_t limits;
+	float junction_deviation;
+	bool async_rapids;		// G0 moves each axis on its own profile instead of a straight line
+	uint8_t underrun_response;	// underrun_response_t, step buffers running dry mid-motion
+	axis_settings_t axis[N_AXIS];
 } settings_t;
 
+extern settings_t settings;
+
+// Restore settings from the compiled in defaults
+void settings_init(void);
+
 
 #endif /* SETTINGS_H_ */
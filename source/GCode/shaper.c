@@ -0,0 +1,144 @@
+/*
+ * shaper.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include <math.h>
+
+#include "shaper.h"
+
+#define SHAPER_ITERATIONS 24    // Bisection steps, narrows the search to 1/16M of the shaper delay
+
+void shaper_init(shaper_t *shaper, shaper_type_t type, float frequency, float damping)
+{
+    float k, half_period, sum;
+
+    if(type == Shaper_None || frequency <= 0.0f || damping < 0.0f || damping >= 1.0f)
+    {
+        shaper->impulses = 1;
+        shaper->amplitude[0] = 1.0f;
+        shaper->time[0] = 0.0f;
+        return;
+    }
+
+    // Ratio of successive half period peaks of the damped resonance
+    k = expf(-damping * (float)M_PI / sqrtf(1.0f - damping * damping));
+    half_period = 0.5f / (frequency * sqrtf(1.0f - damping * damping));
+
+    shaper->time[0] = 0.0f;
+    shaper->time[1] = half_period;
+    shaper->amplitude[0] = 1.0f;
+    shaper->amplitude[1] = type == Shaper_ZV ? k : 2.0f * k;
+    if(type == Shaper_ZV)
+        shaper->impulses = 2;
+    else
+    {
+        shaper->impulses = 3;
+        shaper->time[2] = 2.0f * half_period;
+        shaper->amplitude[2] = k * k;
+    }
+
+    sum = shaper->amplitude[0] + shaper->amplitude[1] + (shaper->impulses == 3 ? shaper->amplitude[2] : 0.0f);
+    shaper->amplitude[0] /= sum;
+    shaper->amplitude[1] /= sum;
+    if(shaper->impulses == 3)
+        shaper->amplitude[2] /= sum;
+}
+
+static float trapezoid_position(const void *profile, float time)
+{
+    return profile_position((const motion_profile_t *)profile, time);
+}
+
+static float trapezoid_time(const void *profile, uint32_t step)
+{
+    return profile_time((const motion_profile_t *)profile, step);
+}
+
+static float scurve_position_of(const void *profile, float time)
+{
+    return scurve_position((const scurve_profile_t *)profile, time);
+}
+
+static float scurve_time_of(const void *profile, uint32_t step)
+{
+    return scurve_time((const scurve_profile_t *)profile, step);
+}
+
+void shaper_move_trapezoid(shaped_move_t *move, const shaper_t *shaper, const motion_profile_t *profile)
+{
+    move->shaper = shaper;
+    move->profile = profile;
+    move->steps = profile->steps;
+    move->position = trapezoid_position;
+    move->time = trapezoid_time;
+}
+
+void shaper_move_scurve(shaped_move_t *move, const shaper_t *shaper, const scurve_profile_t *profile)
+{
+    move->shaper = shaper;
+    move->profile = profile;
+    move->steps = profile->steps;
+    move->position = scurve_position_of;
+    move->time = scurve_time_of;
+}
+
+// Position of the shaped move, the sum of the impulse weighted delayed copies
+static float shaped_position(const shaped_move_t *move, float time)
+{
+    float position = 0.0f, t;
+    uint_fast8_t i;
+
+    for(i = 0; i < move->shaper->impulses; i++)
+    {
+        if((t = time - move->shaper->time[i]) > 0.0f)
+            position += move->shaper->amplitude[i] * move->position(move->profile, t);
+    }
+
+    return position;
+}
+
+float shaper_time(const shaped_move_t *move, uint32_t step)
+{
+    float lo, hi, mid, target = (float)step;
+    uint_fast8_t i;
+
+    lo = move->time(move->profile, step);
+    if(move->shaper->impulses == 1 || step == 0)
+        return lo;
+
+    // Every copy lags the unshaped move, so the step comes at most one shaper delay later
+    hi = lo + shaper_delay(move->shaper);
+    if(step >= move->steps)
+        return hi;
+
+    for(i = 0; i < SHAPER_ITERATIONS; i++)
+    {
+        mid = (lo + hi) * 0.5f;
+        if(shaped_position(move, mid) >= target)
+            hi = mid;
+        else
+            lo = mid;
+    }
+
+    return hi;
+}
+
+uint32_t shaper_segment(const shaped_move_t *move, uint32_t step, uint32_t segment_ticks, uint32_t timer_clock, uint32_t *ticks)
+{
+    float start = shaper_time(move, step), period;
+    uint32_t n, left = move->steps - step;
+
+    // Steps fitting in the segment at the rate of the first one
+    period = (shaper_time(move, step + 1) - start) * (float)timer_clock;
+    n = period >= (float)segment_ticks ? 1 : (uint32_t)((float)segment_ticks / period);
+    if(n > left)
+        n = left;
+
+    period = (shaper_time(move, step + n) - start) * (float)timer_clock / (float)n;
+    *ticks = period >= (float)UINT32_MAX ? UINT32_MAX : (uint32_t)lroundf(period);
+
+    return n;
+}
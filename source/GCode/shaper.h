@@ -0,0 +1,64 @@
+/*
+ * shaper.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Input shaping of point to point moves. The commanded motion is convolved with two (ZV) or
+ *  three (ZVD) impulses spaced half a period of the resonance apart, the vibration each copy
+ *  starts is cancelled by the next one. The move gets longer by the time of the last impulse.
+ *  Works on any profile that can give its position at a time, free of RTOS dependencies so it
+ *  can be built on the host.
+ */
+
+#ifndef GCODE_SHAPER_H_
+#define GCODE_SHAPER_H_
+
+#include <stdint.h>
+
+#include "motion_profile.h"
+
+#define SHAPER_MAX_IMPULSES 3
+
+typedef enum {
+    Shaper_None = 0,
+    Shaper_ZV,              // Zero vibration, shortest, sensitive to the frequency being right
+    Shaper_ZVD              // Zero vibration and derivative, one more half period, more robust
+} shaper_type_t;
+
+typedef struct {
+    uint_fast8_t impulses;
+    float amplitude[SHAPER_MAX_IMPULSES];   // Sums to 1
+    float time[SHAPER_MAX_IMPULSES];        // sec, the first is always 0
+} shaper_t;
+
+// A move run through a shaper. The unshaped time of a step bounds the search for the shaped one.
+typedef struct {
+    const shaper_t *shaper;
+    const void *profile;
+    uint32_t steps;
+    float (*position)(const void *profile, float time);     // Unshaped steps at time
+    float (*time)(const void *profile, uint32_t step);      // Unshaped time of step
+} shaped_move_t;
+
+// Set up impulses for a resonance at frequency Hz with damping ratio damping.
+void shaper_init(shaper_t *shaper, shaper_type_t type, float frequency, float damping);
+
+// Shape a trapezoidal or S-curve profile, the profile must stay in place while the move is used.
+void shaper_move_trapezoid(shaped_move_t *move, const shaper_t *shaper, const motion_profile_t *profile);
+void shaper_move_scurve(shaped_move_t *move, const shaper_t *shaper, const scurve_profile_t *profile);
+
+// Seconds from the start of the shaped move to step, step 0 is the start.
+float shaper_time(const shaped_move_t *move, uint32_t step);
+
+// Steps from step on to run at one constant period for about segment_ticks, the period is
+// returned in ticks. The segment ends on the exact time of its last step.
+uint32_t shaper_segment(const shaped_move_t *move, uint32_t step, uint32_t segment_ticks, uint32_t timer_clock, uint32_t *ticks);
+
+// Time the shaper adds to a move.
+static inline float shaper_delay(const shaper_t *shaper)
+{
+    return shaper->time[shaper->impulses - 1];
+}
+
+#endif /* GCODE_SHAPER_H_ */
@@ -0,0 +1,79 @@
+/*
+ * step_pins.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include "PnPContoller_Main.h"
+#include "step_pins.h"
+#include "pin_mux.h"
+
+typedef struct {
+	GPIO_Type *GPIO;				// NULL while not wired, the axis position is still tracked
+	uint32_t Pin;
+} step_pin_t;
+
+// Pins of the base axes, in axis order
+static const struct {
+	step_pin_t step;
+	step_pin_t direction;
+} pin_map[N_BASE_AXIS] = {
+	{ .step = { BOARD_INITPINS_STEP_X_GPIO, BOARD_INITPINS_STEP_X_GPIO_PIN },
+	  .direction = { BOARD_INITPINS_DIR_X_GPIO, BOARD_INITPINS_DIR_X_GPIO_PIN } },
+	{ .step = { NULL, 0 }, .direction = { NULL, 0 } }
+};
+
+HOT_DATA step_pins_t step_pins;
+
+//
+// Port of a pin, added on first use
+static step_port_t *portOf(GPIO_Type *gpio)
+{
+	uint_fast8_t idx;
+
+	for(idx = 0; idx < step_pins.ports; idx++)
+	{
+		if(step_pins.port[idx].GPIO == gpio)
+			return &step_pins.port[idx];
+	}
+
+	step_pins.port[step_pins.ports].GPIO = gpio;
+
+	return &step_pins.port[step_pins.ports++];
+}
+
+//
+// Add a pin of axis idx to the masks of every set of axis bits holding it
+static void addPin(uint32_t *masks, uint_fast8_t idx, uint32_t pin)
+{
+	uint_fast8_t bits;
+
+	for(bits = 0; bits < (1 << N_BASE_AXIS); bits++)
+	{
+		if(bits & bit(idx))
+			masks[bits] |= 1U << pin;
+	}
+}
+
+void step_pins_init(void)
+{
+	uint_fast8_t idx;
+
+	memset(&step_pins, 0, sizeof(step_pins));
+
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+	{
+		if(pin_map[idx].step.GPIO)
+			addPin(portOf(pin_map[idx].step.GPIO)->step, idx, pin_map[idx].step.Pin);
+		if(pin_map[idx].direction.GPIO)
+			addPin(portOf(pin_map[idx].direction.GPIO)->direction, idx, pin_map[idx].direction.Pin);
+	}
+
+	// Direction pins come up low, axes moving backwards
+	for(idx = 0; idx < step_pins.ports; idx++)
+		step_pins.port[idx].GPIO->DR_CLEAR = step_pins.port[idx].direction[(1 << N_BASE_AXIS) - 1];
+
+	// Timed on the cycle counter started by cycle_counter_init()
+	step_pins.pulse_cycles = (uint32_t)(((uint64_t)STEP_PULSE_MIN_NS * SystemCoreClock) / 1000000000U);
+}
@@ -0,0 +1,102 @@
+/*
+ * step_pins.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Step and direction outputs of the base axes. The pin map in step_pins.c is turned into
+ *  masks per GPIO port at init, indexed by a set of axis bits, so the step ISR raises all
+ *  due step pins of a port with one DR_SET write and lowers them with one DR_CLEAR write.
+ *  The pins themselves are set up as outputs by BOARD_InitPins().
+ */
+
+#ifndef GCODE_STEP_PINS_H_
+#define GCODE_STEP_PINS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fsl_gpio.h"
+#include "placement.h"
+
+// Ports the step and direction pins of the base axes may be spread over
+#define STEP_PORTS_MAX (N_BASE_AXIS * 2)
+
+typedef struct {
+	GPIO_Type *GPIO;
+	uint32_t step[1 << N_BASE_AXIS];		// Step pin mask of each set of axis bits
+	uint32_t direction[1 << N_BASE_AXIS];	// Direction pin mask of each set of axis bits
+} step_port_t;
+
+typedef struct {
+	step_port_t port[STEP_PORTS_MAX];
+	uint_fast8_t ports;
+	uint32_t pulse_cycles;					// STEP_PULSE_MIN_NS in core clock cycles
+	uint32_t raised;						// Cycle count when the step pins went high
+	uint_fast8_t stepBits;					// Axes with the step pin high
+	uint_fast8_t directionBits;				// Axes with the direction pin set, forward
+} step_pins_t;
+
+extern step_pins_t step_pins;
+
+// Builds the port masks, the pulses are timed on the cycle counter
+void step_pins_init(void);
+
+//
+// Raise the step pins of the axes in stepBits
+static inline HOT_CODE void step_pins_set(uint_fast8_t stepBits)
+{
+	uint_fast8_t idx;
+
+	if(!stepBits)
+		return;
+
+	for(idx = 0; idx < step_pins.ports; idx++)
+	{
+		if(step_pins.port[idx].step[stepBits])
+			step_pins.port[idx].GPIO->DR_SET = step_pins.port[idx].step[stepBits];
+	}
+	step_pins.raised = DWT->CYCCNT;
+	step_pins.stepBits = stepBits;
+}
+
+//
+// Lower the step pins raised, once they have been high for the minimum pulse width
+static inline HOT_CODE void step_pins_clear(void)
+{
+	uint_fast8_t idx;
+
+	if(!step_pins.stepBits)
+		return;
+
+	while(DWT->CYCCNT - step_pins.raised < step_pins.pulse_cycles);
+
+	for(idx = 0; idx < step_pins.ports; idx++)
+	{
+		if(step_pins.port[idx].step[step_pins.stepBits])
+			step_pins.port[idx].GPIO->DR_CLEAR = step_pins.port[idx].step[step_pins.stepBits];
+	}
+	step_pins.stepBits = 0;
+}
+
+//
+// Set the direction pins of the axes in directionBits and clear the others. Only written on
+// a change, the step pins must be low.
+static inline HOT_CODE void step_pins_direction(uint_fast8_t directionBits)
+{
+	uint_fast8_t idx, changed = directionBits ^ step_pins.directionBits;
+
+	if(!changed)
+		return;
+
+	for(idx = 0; idx < step_pins.ports; idx++)
+	{
+		if(step_pins.port[idx].direction[changed & directionBits])
+			step_pins.port[idx].GPIO->DR_SET = step_pins.port[idx].direction[changed & directionBits];
+		if(step_pins.port[idx].direction[changed & ~directionBits])
+			step_pins.port[idx].GPIO->DR_CLEAR = step_pins.port[idx].direction[changed & ~directionBits];
+	}
+	step_pins.directionBits = directionBits;
+}
+
+#endif /* GCODE_STEP_PINS_H_ */
@@ -0,0 +1,304 @@
+/*
+ * step_timer.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include "config.h"
+#include "placement.h"
+#include "step_timer.h"
+
+#if defined(STEP_TIMER_SIM)
+
+/*******************************************************************************
+ * Host simulation
+ ******************************************************************************/
+
+#define SIM_CLOCK 66000000
+
+static struct {
+	uint64_t now;
+	uint64_t deadline;				// End of the interval counting down
+	uint32_t period;				// Loaded at the next event, like the PIT LDVAL
+	uint32_t masked;				// step_timer_irq_disable() nesting
+	bool running;
+	bool pending;					// Event not acknowledged by the ISR yet
+	void (*trace)(uint64_t time);
+} sim;
+
+void step_timer_init(void)
+{
+	sim.now = sim.deadline = 0;
+	sim.masked = 0;
+	sim.running = sim.pending = false;
+}
+
+uint32_t step_timer_clock(void)
+{
+	return SIM_CLOCK;
+}
+
+void step_timer_set_period(uint32_t ticks)
+{
+	sim.period = ticks;
+}
+
+void step_timer_start(void)
+{
+	sim.deadline = sim.now + sim.period;
+	sim.running = true;
+}
+
+void step_timer_stop(void)
+{
+	sim.running = false;
+}
+
+bool step_timer_event(void)
+{
+	bool pending = sim.pending;
+
+	sim.pending = false;
+
+	return pending;
+}
+
+//
+// Event at the deadline, or late at the current time if it was masked. The interval after it
+// counts from the deadline like the hardware, intervals ending while masked are lost.
+static void fire(void)
+{
+	sim.now = max(sim.now, sim.deadline);
+	do
+		sim.deadline += sim.period;
+	while(sim.deadline <= sim.now && sim.period);
+
+	sim.pending = true;
+	STEP_TIMER_IRQ_HANDLER();
+	if(sim.trace)
+		sim.trace(sim.now);
+}
+
+void step_timer_irq_disable(void)
+{
+	sim.masked++;
+}
+
+void step_timer_irq_enable(void)
+{
+	if(--sim.masked == 0 && sim.running && sim.deadline <= sim.now)
+		fire();
+}
+
+uint32_t step_timer_sim_advance(uint64_t time)
+{
+	uint32_t n = 0;
+
+	while(sim.running && !sim.masked && sim.deadline <= time)
+	{
+		fire();
+		n++;
+	}
+	sim.now = max(sim.now, time);
+
+	return n;
+}
+
+uint64_t step_timer_sim_next(void)
+{
+	return sim.running && !sim.masked ? sim.deadline : UINT64_MAX;
+}
+
+uint64_t step_timer_sim_now(void)
+{
+	return sim.now;
+}
+
+void step_timer_sim_trace(void (*trace)(uint64_t time))
+{
+	sim.trace = trace;
+}
+
+#else
+
+#include "FreeRTOS.h"
+#include "fsl_clock.h"
+
+#if defined(STEP_TIMER_QTMR)
+
+/*******************************************************************************
+ * Quad timer
+ ******************************************************************************/
+
+#include "fsl_qtmr.h"
+
+#define QTMR_BASE					TMR1
+#define QTMR_CHANNEL				kQTMR_Channel_0
+#define QTMR_IRQ_ID					TMR1_IRQn
+#define QTMR_PART					0x10000U	// Longest interval the 16 bit counter counts out
+
+// The counter restarts from 0 on compare and COMP1 is then loaded from CMPLD1, so the
+// preloaded part is the interval after the one counting down as with the PIT
+static HOT_DATA struct {
+	uint32_t next;					// Period of the interval after the running one
+	uint32_t left;					// Ticks of the running interval after the part counting down
+	uint32_t preload;				// Part in CMPLD1
+} qtmr;
+
+static inline HOT_CODE uint32_t part(uint32_t ticks)
+{
+	return ticks > QTMR_PART ? QTMR_PART : ticks;
+}
+
+static inline HOT_CODE void preload(uint32_t ticks)
+{
+	qtmr.preload = ticks;
+	QTMR_BASE->CHANNEL[QTMR_CHANNEL].CMPLD1 = (uint16_t)(ticks - 1U);
+}
+
+void step_timer_init(void)
+{
+	qtmr_config_t config;
+
+	QTMR_GetDefaultConfig(&config);
+	config.primarySource = kQTMR_ClockDivide_4;
+	QTMR_Init(QTMR_BASE, QTMR_CHANNEL, &config);
+
+	QTMR_BASE->CHANNEL[QTMR_CHANNEL].LOAD = 0;
+	QTMR_BASE->CHANNEL[QTMR_CHANNEL].CTRL |= TMR_CTRL_LENGTH_MASK;
+	QTMR_BASE->CHANNEL[QTMR_CHANNEL].CSCTRL = (QTMR_BASE->CHANNEL[QTMR_CHANNEL].CSCTRL & ~TMR_CSCTRL_CL1_MASK) |
+											  TMR_CSCTRL_CL1(kQTMR_LoadOnComp1);
+
+	QTMR_EnableInterrupts(QTMR_BASE, QTMR_CHANNEL, kQTMR_CompareInterruptEnable);
+	NVIC_SetPriority(QTMR_IRQ_ID, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
+	EnableIRQ(QTMR_IRQ_ID);
+}
+
+uint32_t step_timer_clock(void)
+{
+	return CLOCK_GetFreq(kCLOCK_IpgClk) / 4U;
+}
+
+HOT_CODE void step_timer_set_period(uint32_t ticks)
+{
+	qtmr.next = ticks ? ticks : 1U;
+
+	// A long interval being counted out keeps its next part
+	if(qtmr.left == 0)
+		preload(part(qtmr.next));
+}
+
+HOT_CODE void step_timer_start(void)
+{
+	uint32_t first = part(qtmr.next);
+
+	qtmr.left = qtmr.next - first;
+	QTMR_BASE->CHANNEL[QTMR_CHANNEL].CNTR = 0;
+	QTMR_BASE->CHANNEL[QTMR_CHANNEL].COMP1 = (uint16_t)(first - 1U);
+	preload(qtmr.left ? part(qtmr.left) : part(qtmr.next));
+	QTMR_StartTimer(QTMR_BASE, QTMR_CHANNEL, kQTMR_PriSrcRiseEdge);
+}
+
+HOT_CODE void step_timer_stop(void)
+{
+	QTMR_StopTimer(QTMR_BASE, QTMR_CHANNEL);
+	qtmr.left = 0;
+}
+
+HOT_CODE bool step_timer_event(void)
+{
+	if(!(QTMR_GetStatus(QTMR_BASE, QTMR_CHANNEL) & kQTMR_CompareFlag))
+		return false;
+
+	QTMR_ClearStatusFlags(QTMR_BASE, QTMR_CHANNEL, kQTMR_CompareFlag);
+
+	// The preloaded part is counting down now
+	if(qtmr.left)
+	{
+		qtmr.left -= qtmr.preload;
+		preload(qtmr.left ? part(qtmr.left) : part(qtmr.next));
+		return false;
+	}
+
+	qtmr.left = qtmr.next - qtmr.preload;
+	preload(qtmr.left ? part(qtmr.left) : part(qtmr.next));
+
+	return true;
+}
+
+void step_timer_irq_disable(void)
+{
+	DisableIRQ(QTMR_IRQ_ID);
+}
+
+void step_timer_irq_enable(void)
+{
+	EnableIRQ(QTMR_IRQ_ID);
+}
+
+#else
+
+/*******************************************************************************
+ * PIT
+ ******************************************************************************/
+
+#include "fsl_pit.h"
+
+#define PIT_IRQ_ID					PIT_IRQn
+#define PIT_CHANNEL					kPIT_Chnl_0
+
+void step_timer_init(void)
+{
+	pit_config_t config;
+
+	PIT_GetDefaultConfig(&config);
+	PIT_Init(PIT, &config);
+
+	PIT_EnableInterrupts(PIT, PIT_CHANNEL, kPIT_TimerInterruptEnable);
+	NVIC_SetPriority(PIT_IRQ_ID, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
+	EnableIRQ(PIT_IRQ_ID);
+}
+
+uint32_t step_timer_clock(void)
+{
+	return CLOCK_GetFreq(kCLOCK_PerClk);
+}
+
+HOT_CODE void step_timer_set_period(uint32_t ticks)
+{
+	PIT_SetTimerPeriod(PIT, PIT_CHANNEL, ticks);
+}
+
+HOT_CODE void step_timer_start(void)
+{
+	PIT_StartTimer(PIT, PIT_CHANNEL);
+}
+
+HOT_CODE void step_timer_stop(void)
+{
+	PIT_StopTimer(PIT, PIT_CHANNEL);
+}
+
+HOT_CODE bool step_timer_event(void)
+{
+	if(PIT_GetStatusFlags(PIT, PIT_CHANNEL) != kPIT_TimerFlag)
+		return false;
+
+	PIT_ClearStatusFlags(PIT, PIT_CHANNEL, kPIT_TimerFlag);
+
+	return true;
+}
+
+void step_timer_irq_disable(void)
+{
+	DisableIRQ(PIT_IRQ_ID);
+}
+
+void step_timer_irq_enable(void)
+{
+	EnableIRQ(PIT_IRQ_ID);
+}
+
+#endif
+#endif
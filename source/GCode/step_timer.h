@@ -0,0 +1,76 @@
+/*
+ * step_timer.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Periodic timer driving the step ISR, the backend is selected in config.h. A period set
+ *  while the timer runs takes effect at the next event, the interval counting down is kept.
+ *  A period set while it is stopped is the first interval after step_timer_start().
+ *
+ *  STEP_TIMER_PIT    PIT channel 0 on the 66 MHz periodic clock.
+ *  STEP_TIMER_QTMR   Quad timer 1 channel 0 on the IPG clock / 4. The counter is 16 bits,
+ *                    longer periods are counted out in parts of up to 0x10000 ticks. The
+ *                    interrupt fires at the end of every part, step_timer_event() returns
+ *                    false for all but the last, so a long period costs one ISR entry per
+ *                    part, 1.75 ms at 150 MHz IPG.
+ *  STEP_TIMER_SIM    Host simulation for testing the step timing on Linux, time only moves
+ *                    in step_timer_sim_advance() and every event can be traced. Run by
+ *                    tools/step_sim with the stand-ins of tools/host.
+ */
+
+#ifndef GCODE_STEP_TIMER_H_
+#define GCODE_STEP_TIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(STEP_TIMER_QTMR)
+#define STEP_TIMER_IRQ_HANDLER TMR1_IRQHandler
+#elif defined(STEP_TIMER_SIM)
+#define STEP_TIMER_IRQ_HANDLER step_timer_sim_irq
+#else
+#define STEP_TIMER_IRQ_HANDLER PIT_IRQHandler
+#endif
+
+// Step ISR, defined by stepper.c
+void STEP_TIMER_IRQ_HANDLER(void);
+
+// Sets up the timer stopped, its interrupt enabled at the highest priority allowed to call FreeRTOS
+void step_timer_init(void);
+
+// Ticks per second of the periods
+uint32_t step_timer_clock(void);
+
+void step_timer_set_period(uint32_t ticks);
+
+void step_timer_start(void);
+
+void step_timer_stop(void);
+
+// Called first in the step ISR, acknowledges the interrupt. False if no period has ended.
+bool step_timer_event(void);
+
+// Keep the step ISR from running while its state is changed from a task
+void step_timer_irq_disable(void);
+
+void step_timer_irq_enable(void);
+
+#ifdef STEP_TIMER_SIM
+
+// Runs the step ISR for every event due up to time, then moves the time there. Events due
+// while the interrupt is disabled run when it is enabled again. Returns the number of events.
+uint32_t step_timer_sim_advance(uint64_t time);
+
+// Time of the next event, UINT64_MAX while stopped or disabled
+uint64_t step_timer_sim_next(void);
+
+// Simulated time in ticks
+uint64_t step_timer_sim_now(void);
+
+// Called after each run of the step ISR with the time of its event
+void step_timer_sim_trace(void (*trace)(uint64_t time));
+
+#endif
+
+#endif /* GCODE_STEP_TIMER_H_ */
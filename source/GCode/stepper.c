@@ -0,0 +1,1450 @@
+/*
+ * stepper.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Takes blocks from the look-ahead ring, turns them into step segments and runs all base
+ *  axes from one step timer, see step_timer.h. Each timer tick is a step event of the axis moving the most,
+ *  the other axes step on the same ticks through a Bresenham line so they stay in lockstep.
+ *
+ *  Asynchronous rapids leave the line: a marker segment switches the ISR to scheduling each
+ *  axis from its own segment ring. A min-heap of next step times picks the next event and
+ *  the timer is programmed one event ahead, since a new period only takes effect at the
+ *  next event.
+ *
+ *  With STEP_TIMING_RECURRENCE the ISR computes the periods of acceleration and deceleration
+ *  itself, each phase of a profile is then one segment holding its exact first period.
+ *
+ *  Axes with a jerk setting run their async moves on an S-curve profile, axes with a shaper
+ *  get their async moves convolved with its impulses. Both are cut in segments of constant
+ *  period that end on the exact step times.
+ *
+ *  The stepper thread never polls. When a ring is full it blocks on its task notification,
+ *  the ISR gives it when the ring has drained to its low watermark so it refills in bulk.
+ */
+
+#include "PnPContoller_Main.h"
+#include "spsc_ring.h"
+#include "step_timer.h"
+#include "step_pins.h"
+
+#include "fsl_gpio.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+
+#ifdef STEP_TIMING_RECURRENCE
+#define SEGMENT_BUFFER_SIZE 64		// Power of two, at most three segments per block
+#define ASYNC_BUFFER_SIZE 32		// Power of two, per axis, S-curve segments are SCURVE_SEGMENT_US long
+#define TICKS_FRACTION 8			// Periods are 24.8 fixed point so the recurrence keeps its fraction
+#else
+#define SEGMENT_BUFFER_SIZE 256	// Power of two
+#define SEGMENT_TIME_US 1000		// Length of acceleration and deceleration segments
+#define ASYNC_BUFFER_SIZE 128		// Power of two, per axis
+#define TICKS_FRACTION 0
+#endif
+#define SEGMENT_BATCH 16			// Segments built before they are queued at once
+#define OUTPUT_BUFFER_SIZE 16		// Power of two, output events queued ahead of their segments
+#define LATCH_BUFFER_SIZE 16		// Power of two, switched outputs waiting to be reported
+#define SCURVE_SEGMENT_US 500		// Length of constant period S-curve and shaped segments
+#define SEGMENT_LOW_WATERMARK (SEGMENT_BUFFER_SIZE / 4)	// Segments left when a waiting producer is woken
+#define ASYNC_LOW_WATERMARK (ASYNC_BUFFER_SIZE / 4)
+#define SEGMENT_LOOKAHEAD (SEGMENT_BUFFER_SIZE / 8)		// Segments queued before more blocks are taken from the planner
+#define SEGMENT_LAST_BLOCK (SEGMENT_LOOKAHEAD / 2)		// Segments left when a block nothing follows yet is taken
+#define LOOKAHEAD_START_MS 10		// Blocks wait at most this long with the ISR idle for more to plan against
+#define ASYNC_MARKER 0				// SegmentSteps of the main ring segment starting an async move,
+									// and of the per axis segment ending it
+#define STEP_MIN_TICKS USEC_TO_COUNT(3, timer_clock)
+#define STEP_MAX_TICKS (INT32_MAX >> TICKS_FRACTION)	// Keeps fixed point periods below 2^31 for the recurrence
+#define timerTicks(ticks) max((ticks) >> TICKS_FRACTION, STEP_MIN_TICKS)
+
+/*******************************************************************************
+ * Variables
+ ******************************************************************************/
+
+
+HOT_DATA axis_t Axis_X;
+HOT_DATA axis_t Axis_Y;
+
+static HOT_CONST axis_t * const st_axis[N_BASE_AXIS] = { &Axis_X, &Axis_Y };
+
+// Step events, the fire event is the one the timer counts down to and the pending event
+// the one after it, its period is already loaded
+typedef struct {
+	uint32_t time;					// Async only
+	uint8_t stepBits;
+	uint8_t directionBits;
+	uint8_t outputs;				// Output events switched with the step, coordinated only
+	bool valid;
+} st_event_t;
+
+// Step event state, owned by the ISR once the timer runs. Coordinated events are committed
+// from the segment one event ahead of the timer, like the async ones.
+static HOT_DATA struct {
+	uint32_t SegmentStepsLeft;		// Step events of the segment not committed yet
+	uint32_t SegmentSteps;			// Step events in segment, Bresenham denominator
+	uint32_t Ticks;					// Planned period before the last committed step event
+#ifdef STEP_TIMING_RECURRENCE
+	int32_t  RampIndex;				// Recurrence index of the next step event
+#else
+	int32_t  TicksDelta;			// Added to Ticks after each step event
+#endif
+	uint8_t Outputs;				// Output events to switch with the first step event of the segment
+	uint8_t DirectionBits;			// Bit set for axes of the segment moving forward
+	bool EndAtRest;					// Segment being stepped ends at rest
+	governor_t Governor;			// Feed hold and override of the coordinated segments
+	volatile bool held;				// Timer stopped by a feed hold, the segment is kept
+	volatile bool idle;				// Timer stopped, nothing queued
+	bool async;						// Running an asynchronous move
+	EventBits_t readyBits;			// Set in xMoveReady at the end of the ISR
+	st_event_t fire;				// Coordinated events
+	st_event_t pending;
+} st;
+
+static const stepper_buffer_t async_marker = { .SegmentSteps = ASYNC_MARKER };
+
+static HOT_DATA struct {
+	st_event_t fire;
+	st_event_t pending;
+	uint8_t heap[N_BASE_AXIS];		// Min-heap of axis indexes on NextTime
+	uint_fast8_t heapSize;
+} ev;
+
+static HOT_DATA spsc_ring_t segments;		// stepper_buffer_t, task to ISR
+static HOT_DATA spsc_ring_t async_segments[N_BASE_AXIS];
+static HOT_DATA spsc_ring_t outputs;			// plan_output_t, task to ISR, taken by the segments that start on them
+static HOT_DATA spsc_ring_t latches;			// output_latch_t, ISR to the reporting task
+
+// Base moves handed to the planner and blocks queued to the ISR in full. The ready bits are only
+// set while they are equal, a move counted before the bits are cleared keeps them clear.
+static HOT_DATA struct {
+	volatile uint32_t submitted;	// Planner thread only
+	volatile uint32_t queued;		// Stepper thread only
+} move_count;
+static HOT_DATA struct {
+	TaskHandle_t task;				// Stepper thread
+	spsc_ring_t * volatile waiting;	// Ring it waits on to drain, NULL while it runs
+	volatile uint32_t watermark;	// Count of that ring to wake it at, written before waiting
+} producer;
+static HOT_DATA struct {
+	volatile bool flush;			// Planner waits for the base, take what it has
+	bool started;					// Start delay running with the ISR idle
+	bool expired;					// Start delay over, blocks are taken while the ISR is idle
+	TickType_t since;				// Tick the start delay began at
+} lookahead;
+static HOT_DATA uint32_t timer_clock;
+
+// Base digital outputs, M62/M63 P0 to N_BASE_OUTPUTS - 1
+typedef struct {
+	GPIO_Type *GPIO;				// NULL while not wired, the output is still latched
+	uint32_t Pin;
+} output_pin_t;
+
+static HOT_DATA output_pin_t output_pins[N_BASE_OUTPUTS];
+static HOT_DATA struct {
+	volatile uint32_t expected;		// Handed to the planner, g-code thread only
+	volatile uint32_t reported;		// Latches taken, reporting thread only
+	volatile uint32_t lost;			// Latch ring was full, ISR only
+} output_count;
+
+// Feed hold and override requested by the realtime commands, followed by the ISR
+#define FEED_SCALE_ONE (1 << 8)
+static HOT_DATA struct {
+	volatile bool hold;
+	volatile bool underrun;			// Hold given by the underrun response, resumed by the stepper thread
+	volatile uint32_t scale;		// Period multiplier, 8.8 fixed point
+} feed = { .scale = FEED_SCALE_ONE };
+
+// Low water marks are written by the ISR, high water marks by the stepper thread
+static HOT_DATA stepper_stats_t stats;
+
+/*******************************************************************************
+ * Non-cacheable, mapped to DTCM
+ ******************************************************************************/
+
+AT_NONCACHEABLE_SECTION_ALIGN(static stepper_buffer_t segment_buffer[SEGMENT_BUFFER_SIZE], 64U);
+AT_NONCACHEABLE_SECTION_ALIGN(static stepper_buffer_t async_buffer[N_BASE_AXIS][ASYNC_BUFFER_SIZE], 64U);
+AT_NONCACHEABLE_SECTION_ALIGN(static plan_output_t output_buffer[OUTPUT_BUFFER_SIZE], 64U);
+AT_NONCACHEABLE_SECTION_ALIGN(static output_latch_t latch_buffer[LATCH_BUFFER_SIZE], 64U);
+
+static HOT_CODE bool enterAsync(void);
+
+// Exact period ratios T(m) / T(m - 1) and T(m - 1) / T(m) for the first steps from rest,
+// T(m) = sqrt(m + 1) - sqrt(m). 16.16 fixed point.
+#define RAMP_TABLE_STEPS 16
+static HOT_CONST const uint32_t ramp_ratio[RAMP_TABLE_STEPS] = {
+	27146, 50288, 55249, 57738, 59249, 60267, 60999, 61553,
+	61985, 62333, 62619, 62858, 63060, 63234, 63386, 63518
+};
+static HOT_CONST const uint32_t ramp_ratio_inverse[RAMP_TABLE_STEPS] = {
+	158218, 85408, 77738, 74387, 72490, 71266, 70410, 69777,
+	69290, 68903, 68589, 68328, 68109, 67921, 67759, 67618
+};
+
+//
+// Period of the next step event with Austin's recurrence c(n) = c(n-1) - 2c(n-1) / (4n + 1).
+// The index counts steps from rest and is negative while decelerating. Close to rest the
+// recurrence is far off and the error would carry into every later period, the exact
+// ratios are used there instead. Also ramps the feed hold and override without the recurrence
+// timing, the periods are then whole ticks.
+static inline HOT_CODE uint32_t rampTicks(uint32_t ticks, int32_t *index)
+{
+	int32_t n = *index;
+
+	if(n > 0)
+	{
+		// n - 1 steps from rest, one more to go
+		if(n <= RAMP_TABLE_STEPS)
+			ticks = ((uint64_t)ticks * ramp_ratio[n - 1]) >> 16;
+		else
+			ticks -= ((ticks << 1) + 2 * n) / (uint32_t)(4 * n + 1);
+		(*index)++;
+	}
+	else if(n < -1)
+	{
+		// -n - 1 steps from rest, one less to go
+		if(n >= -RAMP_TABLE_STEPS - 1)
+			ticks = min(((uint64_t)ticks * ramp_ratio_inverse[-n - 2]) >> 16, (uint64_t)STEP_MAX_TICKS << TICKS_FRACTION);
+		else
+			ticks += ((ticks << 1) - 2 * n - 3) / (uint32_t)(-4 * n - 5);
+		(*index)++;
+	}
+
+	return ticks;
+}
+
+//
+// Steps from rest to a period at the acceleration of the first period c0, n = c0^2 / 4T^2
+static inline HOT_CODE int32_t rampSteps(uint32_t restTicks, uint32_t ticks)
+{
+	uint64_t ratio = ((uint64_t)restTicks << 16) / max(ticks, 1);
+
+	ratio = min(ratio, UINT32_MAX);
+
+	return (int32_t)min((ratio * ratio) >> 34, INT32_MAX >> 1);
+}
+
+//
+// Planned period stretched by the feed override
+static inline HOT_CODE uint32_t scaleTicks(uint32_t ticks, uint32_t scale)
+{
+	return (uint32_t)min(((uint64_t)ticks * scale) >> 8, (uint64_t)STEP_MAX_TICKS << TICKS_FRACTION);
+}
+
+//
+// Start following the feed hold and override from rest, a hold already requested stops the
+// stream before its first step event
+static inline HOT_CODE void governorReset(governor_t *gov)
+{
+	gov->Hold = false;
+	gov->Scale = feed.scale;
+	gov->Stopped = false;
+	gov->RampIndex = 0;
+	gov->Ticks = (uint32_t)STEP_MAX_TICKS << TICKS_FRACTION;
+}
+
+//
+// A stream starved mid-motion goes on from rest. Scale 0 is no override, the next govern()
+// takes it as a change and ramps from the rest period up to the planned one like a resume.
+static inline HOT_CODE void governorRestart(governor_t *gov)
+{
+	gov->Scale = 0;
+	gov->Stopped = false;
+	gov->RampIndex = 0;
+	gov->Ticks = (uint32_t)STEP_MAX_TICKS << TICKS_FRACTION;
+}
+
+//
+// Period of the next step event, the planned one stretched by the feed override. A change of
+// override or a feed hold starts a ramp from the period being stepped, at the hold acceleration.
+// The planned period is never beaten, the ramp only slows it. Stopped is set instead of a period
+// when a hold has come to rest, the planned state is kept for the resume.
+static HOT_CODE uint32_t govern(governor_t *gov, uint32_t planned)
+{
+	uint32_t target;
+	int32_t n;
+
+	if(gov->Hold == feed.hold && gov->Scale == feed.scale)
+	{
+		if(gov->RampIndex == 0)
+			return gov->Ticks = gov->Scale == FEED_SCALE_ONE ? planned : scaleTicks(planned, gov->Scale);
+
+		if(gov->RampIndex == -1)
+		{
+			// Ramp has reached rest
+			if(gov->Hold)
+			{
+				gov->Stopped = true;
+				gov->RampIndex = 0;
+				return gov->Ticks = (uint32_t)STEP_MAX_TICKS << TICKS_FRACTION;
+			}
+			gov->RampIndex = 0;
+			return gov->Ticks = scaleTicks(planned, gov->Scale);
+		}
+		gov->Ramp = rampTicks(gov->Ramp, &gov->RampIndex);
+	}
+	else
+	{
+		// Ramp from the period being stepped, it starts with this step event
+		gov->Hold = feed.hold;
+		gov->Scale = feed.scale;
+		gov->Stopped = false;
+		n = rampSteps(gov->RestTicks, gov->Ticks);
+		if(gov->Hold && n == 0)
+		{
+			gov->Stopped = true;
+			gov->RampIndex = 0;
+			return gov->Ticks = (uint32_t)STEP_MAX_TICKS << TICKS_FRACTION;
+		}
+		gov->Ramp = n ? gov->Ticks : gov->RestTicks;
+		gov->RampIndex = (gov->Hold || scaleTicks(planned, gov->Scale) > gov->Ticks) ? -n - 1 : n + 1;
+	}
+
+	target = scaleTicks(planned, gov->Scale);
+	if(gov->RampIndex > 0)
+	{
+		// Speeding up to the override, ends when the ramp gets below it
+		if(gov->Ramp <= target)
+			gov->RampIndex = 0;
+		return gov->Ticks = max(gov->Ramp, target);
+	}
+
+	// Slowing down to rest or to the override, the override is never beaten
+	if(!gov->Hold)
+	{
+		if(gov->Ramp >= target)
+		{
+			gov->RampIndex = 0;
+			return gov->Ticks = target;
+		}
+		return gov->Ticks = max(gov->Ramp, planned);
+	}
+
+	return gov->Ticks = max(gov->Ramp, target);
+}
+
+//
+// Segments left in a ring behind one that must be followed by another. None left means the
+// producer is behind and the configured response is given before the stream runs dry.
+static inline HOT_CODE void checkFill(uint32_t count, uint16_t *low_water)
+{
+	if(count < *low_water)
+		*low_water = count;
+
+	if(count == 0)
+	{
+		stats.near_underruns++;
+		if(settings.underrun_response == Underrun_Decel && !feed.hold)
+			feed.underrun = true;
+		if(settings.underrun_response != Underrun_Wait)
+			feed.hold = true;
+		if(settings.underrun_response == Underrun_Alarm)
+			sys_rt_exec_alarm = Alarm_StepUnderrun;
+	}
+}
+
+//
+// Start committing the step events of the next segment, false when there is none. An async
+// move is only entered with the timer stopped, the coordinated events before it are stepped.
+static inline HOT_CODE bool loadSegment(bool stopped)
+{
+	stepper_buffer_t *segment;
+	uint_fast8_t idx;
+
+	if((segment = spsc_ring_peek(&segments)) == NULL)
+		return false;
+
+	if(segment->SegmentSteps == ASYNC_MARKER)
+	{
+		if(!stopped)
+			return false;
+		spsc_ring_release(&segments);
+		return enterAsync() || loadSegment(true);
+	}
+
+	st.SegmentStepsLeft = st.SegmentSteps = segment->SegmentSteps;
+	st.Ticks = segment->ticks;
+	st.Outputs = segment->Outputs;
+	st.DirectionBits = segment->DirectionBits & ~SEGMENT_END_AT_REST;
+	st.EndAtRest = !!(segment->DirectionBits & SEGMENT_END_AT_REST);
+#ifdef STEP_TIMING_RECURRENCE
+	st.RampIndex = segment->RampIndex;
+#else
+	st.TicksDelta = segment->TicksDelta;
+#endif
+
+	// Start each line half way so steps are spread evenly over the segment
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+	{
+		st_axis[idx]->SegmentSteps = segment->AxisSteps[idx];
+		st_axis[idx]->Counter = segment->SegmentSteps >> 1;
+	}
+	spsc_ring_release(&segments);
+
+	if(!st.EndAtRest)
+		checkFill(spsc_ring_count(&segments), &stats.low_water);
+
+	return true;
+}
+
+//
+// Write an output and latch where the base axes are. The ISR is the only producer of
+// latches, others must keep it from running.
+static inline HOT_CODE void switchOutput(uint8_t port, uint8_t value)
+{
+	output_latch_t *latch;
+	uint_fast8_t idx;
+
+	if(output_pins[port].GPIO)
+		GPIO_PinWrite(output_pins[port].GPIO, output_pins[port].Pin, value);
+
+	if((latch = spsc_ring_reserve(&latches)) == NULL)
+	{
+		output_count.lost++;
+		return;
+	}
+	latch->port = port;
+	latch->value = value;
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+		latch->position[idx] = (int32_t)st_axis[idx]->ActualPos;
+	spsc_ring_commit(&latches);
+}
+
+//
+// Switch the outputs of a segment with its first step event
+static inline HOT_CODE void switchOutputs(uint_fast8_t n)
+{
+	plan_output_t *output;
+
+	for(; n; n--)
+	{
+		if((output = spsc_ring_peek(&outputs)) == NULL)
+			break;
+		switchOutput(output->port, output->value);
+		spsc_ring_release(&outputs);
+	}
+}
+
+//
+// Raise the step pins of an event and count its steps
+static inline HOT_CODE void stepEvent(const st_event_t *event)
+{
+	uint_fast8_t idx;
+
+	step_pins_set(event->stepBits);
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+	{
+		if(event->stepBits & bit(idx))
+			st_axis[idx]->ActualPos += (event->directionBits & bit(idx)) ? 1 : -1;
+	}
+}
+
+//
+// Commit the next coordinated step event and load the period before it, with the timer stopped
+// as its first interval. Not valid when the ring has run dry, or when an async move is next.
+// A feed hold that has come to rest sets Stopped instead of a period.
+static HOT_CODE void coordinatedCommit(st_event_t *event, bool stopped)
+{
+	uint32_t ticks = st.Governor.Ticks;
+	uint_fast8_t idx;
+	axis_t *axis;
+
+	if(st.SegmentStepsLeft == 0)
+	{
+		if(!loadSegment(stopped) || st.async)
+		{
+			event->valid = false;
+			return;
+		}
+	}
+	else
+	{
+#ifdef STEP_TIMING_RECURRENCE
+		if(st.RampIndex)
+			st.Ticks = rampTicks(st.Ticks, &st.RampIndex);
+#else
+		st.Ticks += st.TicksDelta;
+#endif
+	}
+	st.SegmentStepsLeft--;
+
+	event->valid = true;
+	event->stepBits = 0;
+	event->directionBits = st.DirectionBits;
+	event->outputs = st.Outputs;
+	st.Outputs = 0;
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+	{
+		axis = st_axis[idx];
+		if((axis->Counter += axis->SegmentSteps) >= st.SegmentSteps)
+		{
+			axis->Counter -= st.SegmentSteps;
+			event->stepBits |= bit(idx);
+		}
+	}
+
+	if((govern(&st.Governor, st.Ticks) != ticks || stopped) && !st.Governor.Stopped)
+		step_timer_set_period(timerTicks(st.Governor.Ticks));
+}
+
+//
+// Start the stopped timer on the next coordinated step event, or enter the async move that is
+// next. False when nothing is queued. A feed hold at rest keeps the event for the resume.
+static HOT_CODE bool startEvents(void)
+{
+	coordinatedCommit(&st.fire, true);
+	if(!st.fire.valid)
+		return st.async;
+
+	if(st.Governor.Stopped)
+	{
+		st.held = true;
+		return true;
+	}
+
+	step_timer_start();
+	coordinatedCommit(&st.pending, false);
+
+	return true;
+}
+
+//
+// Wrap safe, true if axis a steps before axis b
+static inline HOT_CODE bool heapBefore(uint_fast8_t a, uint_fast8_t b)
+{
+	return (int32_t)(st_axis[a]->NextTime - st_axis[b]->NextTime) < 0;
+}
+
+static HOT_CODE void heapPush(uint_fast8_t idx)
+{
+	uint_fast8_t i = ev.heapSize++, parent;
+
+	while(i && heapBefore(idx, ev.heap[parent = (i - 1) >> 1]))
+	{
+		ev.heap[i] = ev.heap[parent];
+		i = parent;
+	}
+	ev.heap[i] = idx;
+}
+
+static HOT_CODE uint_fast8_t heapPop(void)
+{
+	uint_fast8_t top = ev.heap[0], last = ev.heap[--ev.heapSize], i = 0, child;
+
+	while((child = (i << 1) + 1) < ev.heapSize)
+	{
+		if(child + 1 < ev.heapSize && heapBefore(ev.heap[child + 1], ev.heap[child]))
+			child++;
+		if(!heapBefore(ev.heap[child], last))
+			break;
+		ev.heap[i] = ev.heap[child];
+		i = child;
+	}
+	ev.heap[i] = last;
+
+	return top;
+}
+
+//
+// Move an axis to its next event, false when its part of the move has ended
+static HOT_CODE bool asyncAdvance(uint_fast8_t idx)
+{
+	axis_t *axis = st_axis[idx];
+	stepper_buffer_t *segment;
+	uint32_t ticks;
+
+	if(axis->Held)
+	{
+		// Stopped by a feed hold, the next step is still planned
+		if(feed.hold)
+		{
+			axis->NextTime += USEC_TO_COUNT(FEED_HOLD_POLL_US, timer_clock);
+			return true;
+		}
+		// timerTicks() takes its argument twice, govern() steps the ramp
+		axis->Held = false;
+		ticks = govern(&axis->Governor, axis->Ticks);
+		axis->NextTime += timerTicks(ticks);
+		return true;
+	}
+
+	if(axis->StepsLeft == 0)
+	{
+		if((segment = spsc_ring_peek(&async_segments[idx])) == NULL)
+		{
+			// Producer is behind, look again after one more period without stepping
+			if(!axis->Starved && !axis->EndAtRest)
+			{
+				stats.underruns[idx]++;
+				if(settings.underrun_response == Underrun_Alarm)
+					sys_rt_exec_alarm = Alarm_StepUnderrun;
+			}
+			axis->Starved = true;
+			axis->NextTime += timerTicks(axis->Ticks);
+			return true;
+		}
+
+		if(segment->SegmentSteps == ASYNC_MARKER)
+		{
+			spsc_ring_release(&async_segments[idx]);
+			st.readyBits |= MOVE_READY_AXIS(idx);
+			return false;
+		}
+
+		axis->StepsLeft = segment->SegmentSteps;
+		axis->Ticks = segment->ticks;
+#ifdef STEP_TIMING_RECURRENCE
+		axis->RampIndex = segment->RampIndex;
+#else
+		axis->TicksDelta = segment->TicksDelta;
+#endif
+		axis->DirectionForward = !!(segment->DirectionBits & bit(idx));
+		axis->EndAtRest = !!(segment->DirectionBits & SEGMENT_END_AT_REST);
+		spsc_ring_release(&async_segments[idx]);
+
+		if(!axis->EndAtRest)
+			checkFill(spsc_ring_count(&async_segments[idx]), &stats.async_low_water[idx]);
+		if(axis->Starved)
+			governorRestart(&axis->Governor);
+	}
+	else
+#ifdef STEP_TIMING_RECURRENCE
+		axis->Ticks = rampTicks(axis->Ticks, &axis->RampIndex);
+#else
+		axis->Ticks += axis->TicksDelta;
+#endif
+
+	axis->Starved = false;
+	ticks = govern(&axis->Governor, axis->Ticks);
+	if(axis->Governor.Stopped)
+	{
+		axis->Held = true;
+		axis->NextTime += USEC_TO_COUNT(FEED_HOLD_POLL_US, timer_clock);
+	}
+	else
+		axis->NextTime += timerTicks(ticks);
+
+	return true;
+}
+
+//
+// Take the earliest event from the heap. Axes due within the minimum step period are merged
+// into it, they step slightly early but keep their own schedule.
+static HOT_CODE void asyncCommit(st_event_t *event)
+{
+	uint_fast8_t idx;
+	axis_t *axis;
+
+	if(!(event->valid = ev.heapSize > 0))
+		return;
+
+	event->time = st_axis[ev.heap[0]]->NextTime;
+	event->stepBits = event->directionBits = 0;
+
+	while(ev.heapSize && (st_axis[ev.heap[0]]->NextTime - event->time) <= STEP_MIN_TICKS)
+	{
+		axis = st_axis[idx = heapPop()];
+		if(!axis->Starved && !axis->Held)
+		{
+			event->stepBits |= bit(idx);
+			if(axis->DirectionForward)
+				event->directionBits |= bit(idx);
+			axis->StepsLeft--;
+		}
+		if(asyncAdvance(idx))
+			heapPush(idx);
+	}
+}
+
+//
+// Start an async move at time 0, the timer is restarted for the first event.
+// False if no axis has anything to step.
+static HOT_CODE bool enterAsync(void)
+{
+	uint_fast8_t idx;
+
+	ev.heapSize = 0;
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+	{
+		st_axis[idx]->NextTime = 0;
+		st_axis[idx]->Ticks = 0;
+		st_axis[idx]->StepsLeft = 0;
+		st_axis[idx]->Held = false;
+		st_axis[idx]->EndAtRest = true;
+		governorReset(&st_axis[idx]->Governor);
+		if(asyncAdvance(idx))
+			heapPush(idx);
+	}
+
+	asyncCommit(&ev.fire);
+	if(!ev.fire.valid)
+		return false;
+
+	st.async = true;
+	step_timer_stop();
+	step_timer_set_period(ev.fire.time);
+	step_timer_start();
+
+	asyncCommit(&ev.pending);
+	if(ev.pending.valid)
+		step_timer_set_period(ev.pending.time - ev.fire.time);
+
+	return true;
+}
+
+//
+// Async timer event, step the fire event and commit the one after the pending event
+static inline HOT_CODE void asyncStep(void)
+{
+	stepEvent(&ev.fire);
+
+	if(ev.pending.valid)
+	{
+		ev.fire = ev.pending;
+		asyncCommit(&ev.pending);
+		if(ev.pending.valid)
+			step_timer_set_period(ev.pending.time - ev.fire.time);
+	}
+	else
+	{
+		// Last event done, back to coordinated segments
+		st.async = false;
+		step_timer_stop();
+		governorReset(&st.Governor);
+		if(!startEvents())
+			st.idle = true;
+	}
+}
+
+//
+// Coordinated timer event, step the fire event and commit the one after the pending event
+static inline HOT_CODE void coordinatedStep(void)
+{
+	uint_fast8_t idx;
+
+	stepEvent(&st.fire);
+	if(st.fire.outputs)
+		switchOutputs(st.fire.outputs);
+
+	if(st.pending.valid)
+	{
+		st.fire = st.pending;
+
+		// Feed hold has come to rest, the fire event is stepped on resume
+		if(st.Governor.Stopped)
+		{
+			step_timer_stop();
+			st.held = true;
+		}
+		else
+			coordinatedCommit(&st.pending, false);
+	}
+	else
+	{
+		// Ran dry when the pending event was committed, more may have been queued since
+		step_timer_stop();
+		if(!startEvents())
+		{
+			// Nothing more queued, an underrun if the axes were still moving
+			if(!st.EndAtRest)
+			{
+				for(idx = 0; idx < N_BASE_AXIS; idx++)
+				{
+					if(st_axis[idx]->SegmentSteps)
+						stats.underruns[idx]++;
+				}
+				if(settings.underrun_response == Underrun_Alarm)
+					sys_rt_exec_alarm = Alarm_StepUnderrun;
+			}
+			st.idle = true;
+		}
+	}
+}
+
+//
+// Direction pins for the next step event. Async axes not stepping keep theirs.
+static inline HOT_CODE uint_fast8_t nextDirections(void)
+{
+	if(st.async)
+		return (step_pins.directionBits & ~ev.fire.stepBits) | ev.fire.directionBits;
+
+	return st.fire.directionBits;
+}
+
+//
+// Timer clock ticks at step_timer_clock(), 66 MHz with the PIT
+// The timer only runs while a step event is pending. It stops when the segment buffer runs empty.
+
+HOT_CODE void STEP_TIMER_IRQ_HANDLER(void)
+{
+	BaseType_t woken = pdFALSE;
+
+	// Check if channel has caused the interrupt
+	if(step_timer_event())
+	{
+		PROBE_SCOPE(Probe_StepISR);
+
+		if(st.async)
+			asyncStep();
+		else
+			coordinatedStep();
+
+		// Directions change with the step pins low, a period ahead of the step they are for
+		step_pins_clear();
+		if(!st.idle)
+			step_pins_direction(nextDirections());
+
+		if(producer.waiting && spsc_ring_count(producer.waiting) <= producer.watermark)
+		{
+			producer.waiting = NULL;
+			vTaskNotifyGiveFromISR(producer.task, &woken);
+		}
+
+		// Out of steps and nothing more coming, the planner waits on this
+		if(st.idle && move_count.queued == move_count.submitted)
+			st.readyBits |= MOVE_READY_BASE | MOVE_READY_BASE_AXES;
+
+		// Set by the timer service task, which runs before any other task. If its queue is full
+		// they are kept for the next event, or the stepper thread sets them when none follows.
+		if(st.readyBits)
+		{
+			if(xEventGroupSetBitsFromISR(xMoveReady, st.readyBits, &woken) == pdPASS)
+				st.readyBits = 0;
+			else if(st.idle || st.held)
+				vTaskNotifyGiveFromISR(producer.task, &woken);
+		}
+
+		portYIELD_FROM_ISR(woken);
+	}
+}
+
+//
+// The producer has caught up when it waits, on the ISR or on the planner. An underrun hold is
+// resumed then, a feed hold requested meanwhile is left for cycle start.
+static void underrunResume(void)
+{
+	taskENTER_CRITICAL();
+	if(feed.underrun)
+		stepper_cycle_start();
+	taskEXIT_CRITICAL();
+}
+
+//
+// Block until the ISR has drained a ring to watermark
+static void waitForRoom(spsc_ring_t *ring, uint32_t watermark)
+{
+	// Both volatile, the ISR reads the watermark only once it sees the ring
+	producer.watermark = watermark;
+	producer.waiting = ring;
+
+	underrunResume();
+
+	// The ISR may have drained it before it could see the request
+	if(spsc_ring_count(ring) > watermark)
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+	producer.waiting = NULL;
+}
+
+//
+// Start the idle timer on the queued segments, the step interrupt must be disabled
+static void startSegments(void)
+{
+	governorReset(&st.Governor);
+	if(!st.EndAtRest)
+		governorRestart(&st.Governor);
+	// A feed hold may have come in since it was checked, the first event is then held
+	if(startEvents())
+	{
+		step_pins_direction(nextDirections());
+		st.idle = false;
+	}
+}
+
+//
+// Queue segments, starts the timer if it is idle
+static void queueSegments(const stepper_buffer_t *segment, uint32_t n)
+{
+	uint32_t queued;
+	bool atRest;
+
+	if(n == 0)
+		return;
+	atRest = segment[n - 1].SegmentSteps == ASYNC_MARKER || (segment[n - 1].DirectionBits & SEGMENT_END_AT_REST);
+
+	while(n)
+	{
+		while((queued = spsc_ring_put_bulk(&segments, segment, n)) == 0)
+		{
+			waitForRoom(&segments, SEGMENT_LOW_WATERMARK);
+		}
+		segment += queued;
+		n -= queued;
+		stats.high_water = max(stats.high_water, spsc_ring_count(&segments));
+
+		// The ISR may have run dry before the segments were published, a feed hold keeps it idle.
+		// Started from idle once it can stop on what is queued or has segments in hand.
+		step_timer_irq_disable();
+		if(st.idle && !feed.hold && ((n == 0 && atRest) || spsc_ring_count(&segments) > SEGMENT_LAST_BLOCK))
+			startSegments();
+		step_timer_irq_enable();
+	}
+}
+
+#ifdef STEP_TIMING_RECURRENCE
+
+//
+// Next segment of a profile starting at step event i, returns its number of step events.
+// Each phase is one segment starting from its exact period. The recurrence index is the
+// distance from rest, v^2 / 2a steps at the entry or exit rate plus the steps into the ramp.
+static uint32_t profileSegment(motion_profile_t *profile, uint32_t i, stepper_buffer_t *segment)
+{
+	uint32_t end, cruiseEnd = profile->steps - profile->decel_steps, ticks;
+	float two_a = 2.0f * profile->acceleration;
+
+	if(i < profile->accel_steps)
+	{
+		end = profile->accel_steps;
+		segment->RampIndex = lroundf(profile->entry_rate * profile->entry_rate / two_a) + i + 1;
+	}
+	else if(i < cruiseEnd)
+	{
+		end = cruiseEnd;
+		segment->RampIndex = 0;
+	}
+	else
+	{
+		end = profile->steps;
+		segment->RampIndex = -(lroundf(profile->exit_rate * profile->exit_rate / two_a) + (profile->steps - i));
+	}
+
+	ticks = max(profile_ticks(profile, i, timer_clock), STEP_MIN_TICKS);
+	segment->ticks = min(ticks, STEP_MAX_TICKS) << TICKS_FRACTION;
+	segment->SegmentSteps = min(end - i, UINT16_MAX);
+
+	return segment->SegmentSteps;
+}
+
+#else
+
+//
+// Next segment of a profile starting at step event i, returns its number of step events.
+// Cruise is one segment, acceleration and deceleration are cut in SEGMENT_TIME_US pieces
+// with the period interpolated linearly between the exact values at their ends.
+static uint32_t profileSegment(motion_profile_t *profile, uint32_t i, stepper_buffer_t *segment)
+{
+	uint32_t n, end, cruiseEnd = profile->steps - profile->decel_steps, ticksStart, ticksEnd;
+	uint32_t segmentTicks = USEC_TO_COUNT(SEGMENT_TIME_US, timer_clock);
+	int32_t delta;
+
+	// Min=3us = 198, 2us = 132
+	end = i < profile->accel_steps ? profile->accel_steps : (i < cruiseEnd ? cruiseEnd : profile->steps);
+	ticksStart = max(profile_ticks(profile, i, timer_clock), STEP_MIN_TICKS);
+
+	if(i >= profile->accel_steps && i < cruiseEnd)
+	{
+		n = end - i;
+		delta = 0;
+	}
+	else
+	{
+		n = min(max(segmentTicks / ticksStart, 1), end - i);
+		ticksEnd = max(profile_ticks(profile, i + n - 1, timer_clock), STEP_MIN_TICKS);
+		delta = n > 1 ? (int32_t)lroundf((float)((int32_t)ticksEnd - (int32_t)ticksStart) / (float)(n - 1)) : 0;
+	}
+
+	n = min(n, UINT16_MAX);
+	segment->ticks = ticksStart;
+	segment->TicksDelta = delta;
+	segment->SegmentSteps = n;
+
+	return n;
+}
+
+#endif
+
+//
+// Segment of n step events at a constant period, returns n
+static uint32_t constantSegment(stepper_buffer_t *segment, uint32_t n, uint32_t ticks)
+{
+	ticks = max(ticks, STEP_MIN_TICKS);
+	segment->ticks = min(ticks, STEP_MAX_TICKS) << TICKS_FRACTION;
+#ifdef STEP_TIMING_RECURRENCE
+	segment->RampIndex = 0;
+#else
+	segment->TicksDelta = 0;
+#endif
+	segment->SegmentSteps = n;
+
+	return n;
+}
+
+//
+// First periods from rest at the feed hold acceleration. Coordinated step events stop at the
+// smallest acceleration of the base axes, which no axis exceeds whatever its share of the
+// events, async axes at their own.
+static void holdRestTicks(void)
+{
+	float ticks, coordinated = 0.0f;
+	uint_fast8_t idx;
+
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+	{
+		ticks = sqrtf(2.0f / (settings.axis[idx].acceleration * settings.axis[idx].steps_per_mm)) * timer_clock;
+		ticks = min(ticks, (float)STEP_MAX_TICKS);
+		st_axis[idx]->Governor.RestTicks = (uint32_t)ticks << TICKS_FRACTION;
+		coordinated = max(coordinated, ticks);
+	}
+	st.Governor.RestTicks = (uint32_t)coordinated << TICKS_FRACTION;
+}
+
+//
+// Step out one planner block. The profile is planned in step events of the dominant axis,
+// each segment carries how many of its events step the other axes.
+static void executeBlock(plan_block_t *block, float exit_speed_sqr)
+{
+	float scale = (float)block->step_event_count / block->millimeters;
+	motion_profile_t profile;
+	stepper_buffer_t segment[SEGMENT_BATCH];
+	uint32_t axisSteps[N_BASE_AXIS], done[N_BASE_AXIS] = {0}, next;
+	uint32_t i, n, batch = 0;
+	uint8_t directionBits = 0;
+	uint_fast8_t idx, output = 0;
+
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+	{
+		axisSteps[idx] = labs(block->steps[idx]);
+		if(block->steps[idx] > 0)
+			directionBits |= bit(idx);
+		st_axis[idx]->TargetPos += block->steps[idx];
+	}
+
+	profile_calculate(&profile, block->step_event_count, sqrtf(block->entry_speed_sqr) * scale,
+					  sqrtf(block->nominal_speed_sqr) * scale, sqrtf(exit_speed_sqr) * scale, block->acceleration * scale);
+
+	// Outputs are queued ahead of the segments, all earlier segments have been queued
+	while(spsc_ring_free(&outputs) < block->n_outputs)
+		waitForRoom(&outputs, OUTPUT_BUFFER_SIZE - block->n_outputs);
+	spsc_ring_put_bulk(&outputs, block->outputs, block->n_outputs);
+
+	for(i = 0; i < profile.steps; i += n)
+	{
+		n = profileSegment(&profile, i, &segment[batch]);
+		segment[batch].DirectionBits = directionBits;
+
+		// Segments are cut at output steps, the ISR switches the outputs with the first step event
+		segment[batch].Outputs = 0;
+		for(; output < block->n_outputs && block->outputs[output].step == i; output++)
+			segment[batch].Outputs++;
+		if(output < block->n_outputs && block->outputs[output].step < i + n)
+			n = segment[batch].SegmentSteps = block->outputs[output].step - i;
+
+		// Last one of a block ending at rest may be the last queued
+		if(i + n == profile.steps && exit_speed_sqr == 0.0f)
+			segment[batch].DirectionBits |= SEGMENT_END_AT_REST;
+
+		// Steps of each axis up to the end of this segment, rounded down so the totals are exact
+		for(idx = 0; idx < N_BASE_AXIS; idx++)
+		{
+			next = (uint32_t)(((uint64_t)(i + n) * axisSteps[idx]) / block->step_event_count);
+			segment[batch].AxisSteps[idx] = next - done[idx];
+			done[idx] = next;
+		}
+
+		if(++batch == SEGMENT_BATCH)
+		{
+			queueSegments(segment, batch);
+			batch = 0;
+		}
+	}
+	queueSegments(segment, batch);
+}
+
+//
+// Queue one segment for an axis in an async move. The main ring marker is posted when an
+// axis ring fills up, the ISR must be running the move before it can drain.
+static void queueAsyncSegment(uint_fast8_t idx, const stepper_buffer_t *segment, bool *started)
+{
+	while(spsc_ring_put_bulk(&async_segments[idx], segment, 1) == 0)
+	{
+		if(!*started)
+		{
+			*started = true;
+			queueSegments(&async_marker, 1);
+		}
+		waitForRoom(&async_segments[idx], ASYNC_LOW_WATERMARK);
+	}
+	stats.async_high_water[idx] = max(stats.async_high_water[idx], spsc_ring_count(&async_segments[idx]));
+}
+
+//
+// Step out an asynchronous rapid. Every axis runs a profile from rest to rest at its own max
+// rate and acceleration, an S-curve if it has a jerk limit, shaped if it has a shaper. Segments
+// are produced in the order they will be stepped so no axis gets ahead of the others in the rings.
+static void executeAsyncBlock(plan_block_t *block)
+{
+	motion_profile_t profile[N_BASE_AXIS];
+	scurve_profile_t scurve[N_BASE_AXIS];
+	shaper_t shaper[N_BASE_AXIS];
+	shaped_move_t shaped[N_BASE_AXIS];
+	stepper_buffer_t segment = {0};
+	uint32_t i[N_BASE_AXIS] = {0}, steps[N_BASE_AXIS], ticks, n;
+	uint32_t segmentTicks = USEC_TO_COUNT(SCURVE_SEGMENT_US, timer_clock);
+	float time[N_BASE_AXIS] = {0};
+	uint_fast8_t idx, next;
+	bool started = false;
+
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+	{
+		steps[idx] = labs(block->steps[idx]);
+		shaper_init(&shaper[idx], (shaper_type_t)settings.axis[idx].shaper,
+					settings.axis[idx].shaper_frequency, settings.axis[idx].shaper_damping);
+		if(settings.axis[idx].jerk > 0.0f)
+		{
+			scurve_calculate(&scurve[idx], steps[idx], settings.axis[idx].max_rate / 60.0f * settings.axis[idx].steps_per_mm,
+							 settings.axis[idx].acceleration * settings.axis[idx].steps_per_mm,
+							 settings.axis[idx].jerk * settings.axis[idx].steps_per_mm);
+			shaper_move_scurve(&shaped[idx], &shaper[idx], &scurve[idx]);
+		}
+		else
+		{
+			profile_calculate(&profile[idx], steps[idx], 0.0f,
+							  settings.axis[idx].max_rate / 60.0f * settings.axis[idx].steps_per_mm, 0.0f,
+							  settings.axis[idx].acceleration * settings.axis[idx].steps_per_mm);
+			shaper_move_trapezoid(&shaped[idx], &shaper[idx], &profile[idx]);
+		}
+		st_axis[idx]->TargetPos += block->steps[idx];
+	}
+
+	for(;;)
+	{
+		// Axis whose produced segments end first
+		next = N_BASE_AXIS;
+		for(idx = 0; idx < N_BASE_AXIS; idx++)
+		{
+			if(i[idx] < steps[idx] && (next == N_BASE_AXIS || time[idx] < time[next]))
+				next = idx;
+		}
+		if(next == N_BASE_AXIS)
+			break;
+
+		if(shaper[next].impulses > 1)
+		{
+			n = shaper_segment(&shaped[next], i[next], segmentTicks, timer_clock, &ticks);
+			i[next] += constantSegment(&segment, n, ticks);
+			time[next] = shaper_time(&shaped[next], i[next]);
+		}
+		else if(settings.axis[next].jerk > 0.0f)
+		{
+			n = scurve_segment(&scurve[next], i[next], segmentTicks, timer_clock, &ticks);
+			i[next] += constantSegment(&segment, n, ticks);
+			time[next] = scurve_time(&scurve[next], i[next]);
+		}
+		else
+		{
+			i[next] += profileSegment(&profile[next], i[next], &segment);
+			time[next] = profile_time(&profile[next], i[next]);
+		}
+		segment.DirectionBits = block->steps[next] > 0 ? bit(next) : 0;
+		if(i[next] == steps[next])
+			segment.DirectionBits |= SEGMENT_END_AT_REST;
+		queueAsyncSegment(next, &segment, &started);
+	}
+
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+		queueAsyncSegment(idx, &async_marker, &started);
+
+	if(!started)
+		queueSegments(&async_marker, 1);
+}
+
+void stepper_wake(void)
+{
+	if(producer.task)
+		xTaskNotifyGive(producer.task);
+}
+
+void stepper_flush(void)
+{
+	lookahead.flush = true;
+	stepper_wake();
+}
+
+//
+// Planner empty, the next block waits for the start delay again
+static void lookaheadReset(void)
+{
+	lookahead.flush = false;
+	lookahead.started = false;
+	lookahead.expired = false;
+}
+
+//
+// Blocks stay in the planner while the ISR has enough queued, so they are planned against the
+// moves that follow them. From idle they wait for the planner to fill up, for the planner to
+// run out of input or wait on the base, or for the start delay. Called with the scheduler
+// suspended.
+static bool blockDue(bool last)
+{
+	if(st.idle)
+		return lookahead.flush || lookahead.expired || plan_check_full_buffer();
+
+	lookahead.started = false;
+	lookahead.expired = false;
+
+	return spsc_ring_count(&segments) <= (last ? SEGMENT_LAST_BLOCK : SEGMENT_LOOKAHEAD);
+}
+
+//
+// Wait out the start delay from the first block waiting with the ISR idle, or a new block
+static void startDelay(void)
+{
+	TickType_t elapsed;
+
+	if(!lookahead.started)
+	{
+		lookahead.started = true;
+		lookahead.since = xTaskGetTickCount();
+	}
+
+	elapsed = xTaskGetTickCount() - lookahead.since;
+	if(elapsed >= pdMS_TO_TICKS(LOOKAHEAD_START_MS) ||
+			ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOOKAHEAD_START_MS) - elapsed) == 0)
+		lookahead.expired = true;
+}
+
+void stepper_set_output(uint8_t port, bool value)
+{
+	step_timer_irq_disable();
+	switchOutput(port, value);
+	step_timer_irq_enable();
+}
+
+void stepper_output_expected(void)
+{
+	output_count.expected++;
+}
+
+bool stepper_output_latched(output_latch_t *latch)
+{
+	output_latch_t *oldest;
+
+	if((oldest = spsc_ring_peek(&latches)) == NULL)
+		return false;
+
+	memcpy(latch, oldest, sizeof(output_latch_t));
+	spsc_ring_release(&latches);
+	output_count.reported++;
+
+	return true;
+}
+
+bool stepper_outputs_pending(void)
+{
+	return output_count.expected != output_count.reported + output_count.lost;
+}
+
+void stepper_get_stats(stepper_stats_t *copy)
+{
+	memcpy(copy, &stats, sizeof(stepper_stats_t));
+}
+
+void stepper_reset_stats(void)
+{
+	uint_fast8_t idx;
+
+	step_timer_irq_disable();
+	memset(&stats, 0, sizeof(stepper_stats_t));
+	stats.low_water = SEGMENT_BUFFER_SIZE;
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+		stats.async_low_water[idx] = ASYNC_BUFFER_SIZE;
+	step_timer_irq_enable();
+}
+
+void stepper_feed_hold(void)
+{
+	taskENTER_CRITICAL();
+	feed.hold = true;
+	feed.underrun = false;
+	taskEXIT_CRITICAL();
+}
+
+void stepper_cycle_start(void)
+{
+	step_timer_irq_disable();
+	feed.hold = false;
+	feed.underrun = false;
+	if(st.held)
+	{
+		// Held event steps from rest
+		st.held = false;
+		st.Governor.Stopped = false;
+		govern(&st.Governor, st.Ticks);
+		step_timer_set_period(timerTicks(st.Governor.Ticks));
+		step_timer_start();
+		coordinatedCommit(&st.pending, false);
+	}
+	else if(st.idle)
+		startSegments();
+	step_timer_irq_enable();
+}
+
+void stepper_feed_override(uint8_t percent)
+{
+	percent = min(max(percent, MIN_FEED_RATE_OVERRIDE), MAX_FEED_RATE_OVERRIDE);
+	feed.scale = (DEFAULT_FEED_OVERRIDE * FEED_SCALE_ONE) / percent;
+}
+
+hold_state_t stepper_hold_state(void)
+{
+	uint_fast8_t idx;
+
+	if(!feed.hold)
+		return Hold_NotHolding;
+
+	if(st.async)
+	{
+		// Every axis held or done with its part of the move, and the committed events stepped
+		if(ev.fire.stepBits || (ev.pending.valid && ev.pending.stepBits))
+			return Hold_Pending;
+		for(idx = 0; idx < N_BASE_AXIS; idx++)
+		{
+			if(!st_axis[idx]->Held && !(xEventGroupGetBits(xMoveReady) & MOVE_READY_AXIS(idx)))
+				return Hold_Pending;
+		}
+		return Hold_Complete;
+	}
+
+	return st.held || st.idle ? Hold_Complete : Hold_Pending;
+}
+
+void stepper_move_submitted(void)
+{
+	move_count.submitted++;
+}
+
+void stepper_move_dropped(void)
+{
+	move_count.submitted--;
+}
+
+void AxisReady(void)
+{
+	EventBits_t bits;
+
+	// No move may be submitted between the check and the bits being set
+	vTaskSuspendAll();
+
+	// Also takes over the bits the ISR could not set
+	step_timer_irq_disable();
+	bits = st.readyBits;
+	st.readyBits = 0;
+	if(st.idle && move_count.queued == move_count.submitted)
+		bits |= BaseController.ReadyBit | MOVE_READY_BASE_AXES;
+	step_timer_irq_enable();
+
+	if(bits)
+		xEventGroupSetBits(xMoveReady, bits);
+
+	xTaskResumeAll();
+}
+
+static void stepper_thread(void *arg)
+{
+	plan_block_t *block, exec_block;
+	float exit_speed_sqr = 0.0f;
+	uint_fast8_t idx;
+	bool last, due;
+
+	LWIP_UNUSED_ARG(arg);
+
+	// Init Axis, the step and direction pins are in the pin map of step_pins.c
+	Axis_X.AxisNum = 1;
+	Axis_X.ActualPos = 0;
+	Axis_X.TargetPos = 0;
+	Axis_X.DirectionForward = true;
+
+	Axis_Y.AxisNum = 2;
+	Axis_Y.ActualPos = 0;
+	Axis_Y.TargetPos = 0;
+	Axis_Y.DirectionForward = true;
+
+	// No base outputs are wired yet, output_pins[] stays empty and M62/M63 are only latched
+
+	producer.task = xTaskGetCurrentTaskHandle();
+	spsc_ring_init(&segments, segment_buffer, SEGMENT_BUFFER_SIZE, sizeof(stepper_buffer_t));
+	for(idx = 0; idx < N_BASE_AXIS; idx++)
+		spsc_ring_init(&async_segments[idx], async_buffer[idx], ASYNC_BUFFER_SIZE, sizeof(stepper_buffer_t));
+	spsc_ring_init(&outputs, output_buffer, OUTPUT_BUFFER_SIZE, sizeof(plan_output_t));
+	spsc_ring_init(&latches, latch_buffer, LATCH_BUFFER_SIZE, sizeof(output_latch_t));
+	st.idle = true;
+	st.EndAtRest = true;
+
+	step_pins_init();
+
+	// Set up timer, the ISR wakes this thread so it runs at the highest priority allowed to call FreeRTOS
+	step_timer_init();
+	timer_clock = step_timer_clock();
+	PRINTF("\r\n Step timer clock is: %d \r\n", timer_clock);
+
+	stepper_reset_stats();
+
+	for (;;)
+	{
+		// Copy the block out, its exit speed is fixed from here on
+		vTaskSuspendAll();
+		block = plan_get_current_block();
+		last = block != NULL && !plan_has_next_block();
+		due = block != NULL && blockDue(last);
+		if(due)
+		{
+			memcpy(&exec_block, block, sizeof(plan_block_t));
+			exit_speed_sqr = plan_get_exec_block_exit_speed_sqr();
+			plan_discard_current_block();
+		}
+		else if(block == NULL)
+			lookaheadReset();
+		xTaskResumeAll();
+
+		// Woken by the planner when it adds a block, or by the ISR with ready bits it could not
+		// set or with the ring drained
+		if(!due)
+		{
+			underrunResume();
+			if(block == NULL)
+				ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			else if(st.idle)
+				startDelay();
+			else
+				waitForRoom(&segments, last ? SEGMENT_LAST_BLOCK : SEGMENT_LOOKAHEAD);
+			AxisReady();
+			continue;
+		}
+
+		// A slot is free for the planner
+		plan_wake();
+
+		// Settings may have changed since the last block
+		holdRestTicks();
+
+		if(exec_block.condition.async_motion)
+			executeAsyncBlock(&exec_block);
+		else
+			executeBlock(&exec_block, exit_speed_sqr);
+		move_count.queued++;
+
+		// The ISR may have run out before the block was marked done
+		AxisReady();
+	}
+}
+
+/*-----------------------------------------------------------------------------------*/
+void
+stepper_init(void)
+{
+  sys_thread_new("stepper_thread", stepper_thread, NULL, 1000, 10);
+}
+/*-----------------------------------------------------------------------------------*/
@@ -0,0 +1,87 @@
+/*
+ * stepper.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#ifndef GCODE_STEPPER_H_
+#define GCODE_STEPPER_H_
+
+// Base output switched by the step ISR and where the base axes were at that step event
+typedef struct {
+	uint8_t port;
+	uint8_t value;
+	int32_t position[N_BASE_AXIS];	// Steps
+} output_latch_t;
+
+// Response to the step buffers running dry mid-motion, settings.underrun_response. It is given
+// when the last queued segment of a stream is started and more has to follow.
+typedef enum {
+	Underrun_Wait = 0,				// Starved stream pauses and ramps up again from rest
+	Underrun_Decel,					// Feed hold with the steps still queued, resumed once caught up
+	Underrun_Alarm					// Feed hold and Alarm_StepUnderrun, resumed with cycle start
+} underrun_response_t;
+
+// Step buffer statistics, fill levels are in segments. The low water marks are sampled when a
+// segment is started that has to be followed by another one, 0 is a near underrun.
+typedef struct {
+	uint32_t underruns[N_BASE_AXIS];		// Moving axis ran out of segments
+	uint32_t near_underruns;				// Last queued segment started mid-motion
+	uint16_t low_water;						// Coordinated segment ring
+	uint16_t high_water;
+	uint16_t async_low_water[N_BASE_AXIS];	// Async ring of each axis
+	uint16_t async_high_water[N_BASE_AXIS];
+} stepper_stats_t;
+
+// Copies the step buffer statistics since start or the last reset
+void stepper_get_stats(stepper_stats_t *stats);
+
+void stepper_reset_stats(void);
+
+// Switches a base output now and latches it, for outputs of blocks without steps
+void stepper_set_output(uint8_t port, bool value);
+
+// Counts a base output handed to the planner, the reporting thread polls until it is latched
+void stepper_output_expected(void);
+
+// Takes the oldest latched output, false if there is none
+bool stepper_output_latched(output_latch_t *latch);
+
+// True while expected outputs have not been taken
+bool stepper_outputs_pending(void);
+
+// Feed hold, base motion decelerates to rest and waits for stepper_cycle_start(). Queued moves
+// are kept, a hold between moves keeps the next one from starting.
+void stepper_feed_hold(void);
+
+// Resumes from a feed hold, the interrupted move accelerates from rest
+void stepper_cycle_start(void);
+
+// Stretches base motion to a percentage of the planned rate, MIN_FEED_RATE_OVERRIDE to
+// MAX_FEED_RATE_OVERRIDE. The step ISR ramps to it at the feed hold acceleration.
+void stepper_feed_override(uint8_t percent);
+
+// Hold_Pending while decelerating, Hold_Complete at rest
+hold_state_t stepper_hold_state(void);
+
+// Counts a base move before the planner clears the base bits in xMoveReady, the ISR leaves them
+// clear until it has been stepped out. Called from the planner thread only.
+void stepper_move_submitted(void);
+
+// Takes back the count of a move the planner dropped, it had nothing to step
+void stepper_move_dropped(void);
+
+// Sets the base bits in xMoveReady if all submitted base moves have been stepped out
+void AxisReady(void);
+
+// Wakes the stepper thread after a block has been added to the planner
+void stepper_wake(void);
+
+// Starts the last block in the planner without waiting for one to follow it, the planner
+// calls it before it waits for the base to be ready or for more input
+void stepper_flush(void);
+
+void stepper_init(void);
+
+#endif /* GCODE_STEPPER_H_ */
@@ -81,7 +81,8 @@ typedef enum {
     Alarm_EStop = 10,
     Alarm_HomingRequried = 11,
     Alarm_LimitsEngaged = 12,
-    Alarm_ProbeProtect = 13
+    Alarm_ProbeProtect = 13,
+    Alarm_StepUnderrun = 14
 } alarm_code_t;
 
 typedef enum {
@@ -223,6 +224,7 @@ typedef struct {
 } system_t;
 
 extern system_t sys;
+extern volatile uint_fast16_t sys_rt_exec_alarm;   // Alarm raised by an ISR, reported by the telnet session
 
 // NOTE: These position variables may need to be declared as volatiles, if problems arise.
 extern int32_t sys_position[N_AXIS];      // Real-time machine (aka home) position vector in steps.
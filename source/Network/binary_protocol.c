@@ -0,0 +1,167 @@
+/*
+ * binary_protocol.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include "PnPContoller_Main.h"
+
+#include "lwip/opt.h"
+#include "task.h"
+
+#include "lwip/sys.h"
+#include "lwip/api.h"
+
+#include "binary_protocol.h"
+
+// Acks are collected and sent in one write per received netbuf
+#define BIN_ACK_BUFFER 32
+
+typedef struct {
+  struct netconn *conn;
+  uint16_t rx_len;                          // Bytes of a record split between fragments
+  uint8_t rx[sizeof(bin_block_t)];
+  uint16_t n_acks;
+  bin_ack_t ack[BIN_ACK_BUFFER];
+} bin_session_t;
+
+static bin_session_t session;
+
+/*-----------------------------------------------------------------------------------*/
+static err_t
+binary_flush(bin_session_t *session)
+{
+  err_t err = ERR_OK;
+
+  if (session->n_acks) {
+    err = netconn_write(session->conn, session->ack, session->n_acks * sizeof(bin_ack_t), NETCONN_COPY);
+    session->n_acks = 0;
+  }
+
+  return err;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+binary_ack(bin_session_t *session, uint32_t seq, status_code_t status)
+{
+  extern QueueHandle_t xPlannerQueue;
+  bin_ack_t *ack;
+
+  if (session->n_acks == BIN_ACK_BUFFER)
+    binary_flush(session);
+
+  ack = &session->ack[session->n_acks++];
+  ack->sync = BIN_SYNC;
+  ack->type = BinRecord_Ack;
+  ack->status = (uint8_t)status;
+  ack->planner_free = (uint8_t)uxQueueSpacesAvailable(xPlannerQueue);
+  ack->seq = seq;
+}
+/*-----------------------------------------------------------------------------------*/
+// Map a record onto a parser block and queue it for the planner
+static status_code_t
+binary_block(const bin_block_t *record)
+{
+  static parser_block_t gc_block;
+  status_code_t status;
+
+  if ((status = binary_record_block(record, &gc_block)) != Status_OK)
+    return status;
+
+  // Blocks while the planner queue is full, the ack is held back until then
+  return mc_line(&gc_block);
+}
+/*-----------------------------------------------------------------------------------*/
+// Reassemble fixed size records from a received fragment
+static void
+binary_input(bin_session_t *session, const uint8_t *data, uint16_t len)
+{
+  const bin_block_t *record;
+  uint16_t n;
+
+  while (len) {
+
+    // Hunt for sync at record start, resynchronizes after garbage
+    if (session->rx_len == 0 && *data != BIN_SYNC) {
+      data++;
+      len--;
+      continue;
+    }
+
+    // Whole record in the fragment, use it in place
+    if (session->rx_len == 0 && len >= sizeof(bin_block_t) && ((uintptr_t)data & 3) == 0) {
+      record = (const bin_block_t *)data;
+      n = sizeof(bin_block_t);
+    } else {
+      n = min(len, sizeof(bin_block_t) - session->rx_len);
+      memcpy(&session->rx[session->rx_len], data, n);
+      if ((session->rx_len += n) < sizeof(bin_block_t))
+        break;
+      record = (const bin_block_t *)session->rx;
+      session->rx_len = 0;
+    }
+
+    binary_ack(session, record->seq, binary_block(record));
+
+    data += n;
+    len -= n;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+binary_thread(void *arg)
+{
+  struct netconn *conn, *newconn;
+  err_t err;
+
+  LWIP_UNUSED_ARG(arg);
+
+  /* Create a new connection identifier. */
+  conn = netconn_new(NETCONN_TCP);
+  netconn_bind(conn, IP_ADDR_ANY, BIN_PORT);
+
+  LWIP_ERROR("binary: invalid conn", (conn != NULL), return;);
+
+  /* Tell connection to go into listening mode. */
+  netconn_listen(conn);
+
+  while (1) {
+
+    /* Grab new connection. */
+    err = netconn_accept(conn, &newconn);
+    /* Process the new connection. */
+    if (err == ERR_OK) {
+      struct netbuf *buf;
+      void *data;
+      u16_t len;
+
+      session.conn = newconn;
+      session.rx_len = 0;
+      session.n_acks = 0;
+
+      while (err == ERR_OK && (err = netconn_recv(newconn, &buf)) == ERR_OK)
+      {
+        do
+        {
+            netbuf_data(buf, &data, &len);
+            binary_input(&session, data, len);
+        }
+        while (netbuf_next(buf) >= 0);
+        netbuf_delete(buf);
+
+        err = binary_flush(&session);
+      }
+      /* Close connection and discard connection identifier. */
+      netconn_close(newconn);
+      netconn_delete(newconn);
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+void
+binary_init(void)
+{
+  sys_thread_new("binary_thread", binary_thread, NULL, 500, DEFAULT_THREAD_PRIO);
+}
+/*-----------------------------------------------------------------------------------*/
@@ -0,0 +1,80 @@
+/*
+ * binary_protocol.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Binary motion block protocol on its own TCP port. For hosts that already know exact
+ *  targets, feeds and outputs: blocks skip text scanning and parsing and are queued
+ *  straight to the planner.
+ *
+ *  All fields are little-endian. The host sends bin_block_t records back to back, each one
+ *  is answered with a bin_ack_t once it has been queued for the planner (or rejected).
+ *  Targets are absolute machine positions for all axes; the g-code parser position is not
+ *  updated, so do not interleave moves with the g-code port.
+ *
+ *  binary_record.c checks records and maps them onto parser blocks, binary_protocol.c takes
+ *  them from the connection and queues the blocks. The first has no FreeRTOS or lwIP
+ *  dependencies so that it can be linked into the host tools as well.
+ */
+
+#ifndef NETWORK_BINARY_PROTOCOL_H_
+#define NETWORK_BINARY_PROTOCOL_H_
+
+#include <stdint.h>
+#include "nuts_bolts.h"
+#include "GCode.h"
+
+#define BIN_PORT 2323
+#define BIN_SYNC 0xA5
+
+typedef enum {
+    BinRecord_Block = 0x01,
+    BinRecord_Ack = 0x81
+} bin_record_t;
+
+// bin_block_t.controllers, one bit per parser_block_t.controlers member
+#define BIN_CTRL_BASE    bit(0)
+#define BIN_CTRL_HEAD    bit(1)
+#define BIN_CTRL_FEEDER1 bit(2)
+#define BIN_CTRL_FEEDER2 bit(3)
+
+// bin_block_t.output_flags
+#define BIN_OUTPUT_VALID   bit(0) // The output_xxx fields hold an output command
+#define BIN_OUTPUT_DIGITAL bit(1)
+
+// Motion block, 56 bytes. Fields map directly onto parser_block_t.
+typedef struct {
+    uint8_t  sync;            // BIN_SYNC
+    uint8_t  type;            // BinRecord_Block
+    uint8_t  motion;          // MotionMode_Seek (G0) or MotionMode_Linear (G1)
+    uint8_t  controllers;     // BIN_CTRL_xxx -> controlers
+    uint32_t seq;             // Echoed in the ack
+    float    f;               // Feed rate mm/min -> values.f, ignored for G0
+    float    xyz[N_AXIS];     // Absolute targets in mm -> values.xyz
+    int32_t  output_value;    // -> output_commands[0].value
+    float    output_distance; // -> output_commands[0].distance, mm along the move as M62/M63 Q
+    uint8_t  output_port;     // -> output_commands[0].port
+    uint8_t  output_flags;    // BIN_OUTPUT_xxx
+    uint8_t  reserved;
+    uint8_t  checksum;        // calc_checksum() of the preceding 55 bytes
+} bin_block_t;
+
+// Acknowledge, 8 bytes
+typedef struct {
+    uint8_t  sync;          // BIN_SYNC
+    uint8_t  type;          // BinRecord_Ack
+    uint8_t  status;        // status_code_t
+    uint8_t  planner_free;  // Free blocks in the planner queue
+    uint32_t seq;
+} bin_ack_t;
+
+_Static_assert(sizeof(bin_block_t) == 24 + 4 * N_AXIS, "bin_block_t layout");
+_Static_assert(sizeof(bin_ack_t) == 8, "bin_ack_t layout");
+
+// Checks a record and maps it onto gc_block, Status_OK if the block can be queued
+status_code_t binary_record_block(const bin_block_t *record, parser_block_t *gc_block);
+
+void binary_init(void);
+
+#endif /* NETWORK_BINARY_PROTOCOL_H_ */
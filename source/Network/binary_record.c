@@ -0,0 +1,53 @@
+/*
+ * binary_record.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include <string.h>
+#include <stddef.h>
+
+#include "binary_protocol.h"
+
+/*-----------------------------------------------------------------------------------*/
+status_code_t
+binary_record_block(const bin_block_t *record, parser_block_t *gc_block)
+{
+  output_command_t output;
+
+  if (record->type != BinRecord_Block)
+    return Status_InvalidStatement;
+
+  if (record->checksum != calc_checksum((uint8_t *)record, offsetof(bin_block_t, checksum)))
+    return Status_SettingReadFail;
+
+  if (!(record->motion == MotionMode_Seek || record->motion == MotionMode_Linear))
+    return Status_GcodeUnsupportedCommand;
+
+  if (record->motion == MotionMode_Linear && !(record->f > 0.0f))
+    return Status_GcodeUndefinedFeedRate;
+
+  memset(gc_block, 0, sizeof(parser_block_t));
+  gc_block->modal.motion = (motion_mode_t)record->motion;
+  gc_block->values.f = record->f;
+  memcpy(gc_block->values.xyz, record->xyz, sizeof(gc_block->values.xyz));
+
+  gc_block->controlers.Ctrl_Base = !!(record->controllers & BIN_CTRL_BASE);
+  gc_block->controlers.Ctrl_Head = !!(record->controllers & BIN_CTRL_HEAD);
+  gc_block->controlers.Ctrl_Feeder1 = !!(record->controllers & BIN_CTRL_FEEDER1);
+  gc_block->controlers.Ctrl_Feeder2 = !!(record->controllers & BIN_CTRL_FEEDER2);
+
+  // Switched along the motion, as M62/M63 with Q
+  if (record->output_flags & BIN_OUTPUT_VALID) {
+    memset(&output, 0, sizeof(output));
+    output.is_digital = !!(record->output_flags & BIN_OUTPUT_DIGITAL);
+    output.port = record->output_port;
+    output.value = record->output_value;
+    output.distance = record->output_distance;
+    gc_block_add_output(gc_block, &output);
+  }
+
+  return Status_OK;
+}
+/*-----------------------------------------------------------------------------------*/
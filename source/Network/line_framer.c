@@ -0,0 +1,76 @@
+/*
+ * line_framer.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include <string.h>
+
+#include "line_framer.h"
+
+void line_framer_reset(line_framer_t *framer)
+{
+	framer->len = 0;
+	framer->overflow = false;
+}
+
+//
+// Split a run of the stream without realtime commands into lines
+static void frame(line_framer_t *framer, const char *data, const char *end, line_handler_ptr handler, void *context)
+{
+	const char *eol;
+	uint16_t n;
+
+	while(data < end)
+	{
+		eol = memchr(data, '\n', end - data);
+		n = (eol ? eol : end) - data;
+
+		// Append to a line started in an earlier fragment, or discard if too long
+		if(framer->overflow || framer->len + n > LINE_FRAMER_MAX_LINE)
+		{
+			framer->overflow = true;
+			framer->len = 0;
+		}
+		else if(framer->len || !eol)
+		{
+			memcpy(&framer->carry[framer->len], data, n);
+			framer->len += n;
+		}
+
+		if(!eol)
+			break;
+
+		// Complete line, pass it on from the fragment if nothing was carried over
+		if(framer->overflow)
+			handler(NULL, 0, true, context);
+		else if(framer->len)
+			handler(framer->carry, framer->len, false, context);
+		else
+			handler(data, n, false, context);
+
+		line_framer_reset(framer);
+		data = eol + 1;
+	}
+}
+
+void line_framer_input(line_framer_t *framer, const char *data, uint16_t len, line_handler_ptr handler, void *context)
+{
+	const char *end = data + len, *c;
+
+	// Lines around a realtime command are joined by the carry-over
+	if(framer->realtime)
+	{
+		for(c = data; c < end; c++)
+		{
+			if(line_framer_is_realtime(*c) && framer->realtime(*c))
+			{
+				frame(framer, data, c, handler, context);
+				data = c + 1;
+			}
+		}
+	}
+
+	frame(framer, data, end, handler, context);
+}
@@ -0,0 +1,50 @@
+/*
+ * line_framer.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Splits a TCP byte stream into lines. A segment may carry several lines and
+ *  a line may be split over several segments or pbufs. Realtime commands are
+ *  picked off the stream before it is split, wherever they are in a line.
+ */
+
+#ifndef NETWORK_LINE_FRAMER_H_
+#define NETWORK_LINE_FRAMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Longest line accepted, excluding the terminating '\n'. Also the size of the
+// carry-over buffer for lines split between segments.
+#ifndef LINE_FRAMER_MAX_LINE
+#define LINE_FRAMER_MAX_LINE 128
+#endif
+
+// Called once for every complete line. The line is not terminated and is only valid
+// during the call. overflow is set, and len is zero, if the line was too long.
+typedef void (*line_handler_ptr)(const char *line, uint16_t len, bool overflow, void *context);
+
+// Offered every byte that may be a realtime command: '!', '?', '~', control characters other
+// than tab, CR and LF, and bytes from 0x80. Returns true if it was one, it is then taken out
+// of the stream.
+typedef bool (*realtime_handler_ptr)(char c);
+
+#define line_framer_is_realtime(c) ((uint8_t)(c) >= 0x7F || (c) == '!' || (c) == '?' || (c) == '~' || \
+                                    ((uint8_t)(c) < ' ' && (c) != '\t' && (c) != '\r' && (c) != '\n'))
+
+typedef struct {
+    realtime_handler_ptr realtime;      // NULL if the stream has no realtime commands, kept on reset
+    uint16_t len;                       // Number of bytes held in carry
+    bool overflow;                      // Current line is too long and is being discarded
+    char carry[LINE_FRAMER_MAX_LINE];   // Start of a line split between segments
+} line_framer_t;
+
+// Discard any partial line, call when a new connection is accepted
+void line_framer_reset(line_framer_t *framer);
+
+// Feed one received fragment (e.g. one pbuf of a netbuf chain). Complete lines are passed
+// to handler, straight from data when the line is contained in the fragment.
+void line_framer_input(line_framer_t *framer, const char *data, uint16_t len, line_handler_ptr handler, void *context);
+
+#endif /* NETWORK_LINE_FRAMER_H_ */
@@ -47,11 +47,258 @@
 #include "lwip/api.h"
 
 
+#include "line_framer.h"
+#include "telnet.h"
+
+// Replies are collected and sent in one write per received netbuf
+#define TELNET_REPLY_SIZE 1024
+// Longest single reply, see telnet_reply(), telnet_stats() and telnet_probes()
+#define TELNET_REPLY_MAX 272
+// Receive timeout (ms) used to pick up acks from the parser while lines are outstanding
+#define TELNET_ACK_POLL_MS 1
+
+typedef struct {
+  struct netconn *conn;
+  line_framer_t framer;
+  uint32_t first_seq;       // First sequence number of this connection
+  uint32_t outstanding;     // Lines queued to the parser but not acknowledged yet
+  uint32_t underruns;       // Underruns and near underruns reported
+  u16_t reply_len;
+  char reply[TELNET_REPLY_SIZE];
+} telnet_session_t;
+
+static telnet_session_t session;
+static uint32_t next_seq = 1;
+
+/*-----------------------------------------------------------------------------------*/
+static err_t
+telnet_flush(telnet_session_t *session)
+{
+  err_t err = ERR_OK;
+
+  if (session->reply_len) {
+    err = netconn_write(session->conn, session->reply, session->reply_len, NETCONN_COPY);
+    session->reply_len = 0;
+  }
+
+  return err;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+telnet_reply(telnet_session_t *session, uint32_t seq, status_code_t status)
+{
+  extern MessageBufferHandle_t xInBuffer;
+  extern QueueHandle_t xPlannerQueue;
+
+  char *reply;
+
+  if (session->reply_len > TELNET_REPLY_SIZE - TELNET_REPLY_MAX)
+    telnet_flush(session);
+
+  reply = &session->reply[session->reply_len];
+
+  if (status == Status_OK)
+    reply += sprintf(reply, "ok");
+  else
+    reply += sprintf(reply, "error:%d", (int)status);
+
+  reply += sprintf(reply, "|Ln:%lu|Bf:%u,%u\r\n", (unsigned long)seq,
+                   (unsigned)uxQueueSpacesAvailable(xPlannerQueue), (unsigned)xMessageBufferSpacesAvailable(xInBuffer));
+
+  session->reply_len = reply - session->reply;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+telnet_collect_acks(telnet_session_t *session)
+{
+  extern QueueHandle_t xAckQueue;
+  line_ack_t ack;
+
+  while (xQueueReceive(xAckQueue, &ack, 0) == pdPASS) {
+    // Lines from an earlier connection may still be executing, drop their acks
+    if ((int32_t)(ack.seq - session->first_seq) >= 0) {
+      telnet_reply(session, ack.seq, ack.status);
+      if (session->outstanding)
+        session->outstanding--;
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+telnet_collect_outputs(telnet_session_t *session)
+{
+  output_latch_t latch;
+  char *reply;
+
+  while (stepper_output_latched(&latch)) {
+    if (session->reply_len > TELNET_REPLY_SIZE - TELNET_REPLY_MAX)
+      telnet_flush(session);
+
+    reply = &session->reply[session->reply_len];
+    reply += sprintf(reply, "[OUT:%u,%u|Pos:%ld,%ld]\r\n", (unsigned)latch.port, (unsigned)latch.value,
+                     (long)latch.position[X_AXIS], (long)latch.position[Y_AXIS]);
+    session->reply_len = reply - session->reply;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static uint32_t
+telnet_underruns(const stepper_stats_t *stats)
+{
+  return stats->underruns[X_AXIS] + stats->underruns[Y_AXIS] + stats->near_underruns;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+telnet_collect_underruns(telnet_session_t *session)
+{
+  stepper_stats_t stats;
+  uint32_t count;
+
+  // Counted by the step ISR, $STR may have reset them since
+  stepper_get_stats(&stats);
+  count = telnet_underruns(&stats);
+  if (count > session->underruns) {
+    if (session->reply_len > TELNET_REPLY_SIZE - TELNET_REPLY_MAX)
+      telnet_flush(session);
+    session->reply_len += sprintf(&session->reply[session->reply_len], "[UNDERRUN:%lu,%lu|Near:%lu]\r\n",
+                                  (unsigned long)stats.underruns[X_AXIS], (unsigned long)stats.underruns[Y_AXIS],
+                                  (unsigned long)stats.near_underruns);
+  }
+  session->underruns = count;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+telnet_collect_alarm(telnet_session_t *session)
+{
+  uint_fast16_t alarm;
+
+  // Raised by the step ISR, reported once
+  if ((alarm = sys_rt_exec_alarm) != Alarm_None) {
+    sys_rt_exec_alarm = Alarm_None;
+    if (session->reply_len > TELNET_REPLY_SIZE - TELNET_REPLY_MAX)
+      telnet_flush(session);
+    session->reply_len += sprintf(&session->reply[session->reply_len], "ALARM:%u\r\n", (unsigned)alarm);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static bool
+telnet_stats(telnet_session_t *session, const char *data, uint16_t len)
+{
+  stepper_stats_t stats;
+  char *reply;
+
+  if (len && data[len - 1] == '\r')
+    len--;
+
+  // $ST reports the step buffer statistics, $STR also resets them
+  if (len < 3 || len > 4 || strncmp(data, "$ST", 3) || (len == 4 && data[3] != 'R'))
+    return false;
+
+  stepper_get_stats(&stats);
+  if (len == 4)
+    stepper_reset_stats();
+
+  if (session->reply_len > TELNET_REPLY_SIZE - TELNET_REPLY_MAX)
+    telnet_flush(session);
+
+  reply = &session->reply[session->reply_len];
+  reply += sprintf(reply, "[ST:Seg:%u,%u|Async:%u,%u,%u,%u|Under:%lu,%lu|Near:%lu]\r\n",
+                   (unsigned)stats.low_water, (unsigned)stats.high_water,
+                   (unsigned)stats.async_low_water[X_AXIS], (unsigned)stats.async_high_water[X_AXIS],
+                   (unsigned)stats.async_low_water[Y_AXIS], (unsigned)stats.async_high_water[Y_AXIS],
+                   (unsigned long)stats.underruns[X_AXIS], (unsigned long)stats.underruns[Y_AXIS],
+                   (unsigned long)stats.near_underruns);
+  session->reply_len = reply - session->reply;
+
+  return true;
+}
+/*-----------------------------------------------------------------------------------*/
+#ifdef CYCLE_PROBES
+static bool
+telnet_probes(telnet_session_t *session, const char *data, uint16_t len)
+{
+  probe_stats_t stats;
+  probe_id_t id;
+  uint_fast8_t bin;
+  char *reply;
+
+  if (len && data[len - 1] == '\r')
+    len--;
+
+  // $PR reports the cycle probes, $PRR also resets them
+  if (len < 3 || len > 4 || strncmp(data, "$PR", 3) || (len == 4 && data[3] != 'R'))
+    return false;
+
+  if (session->reply_len > TELNET_REPLY_SIZE - TELNET_REPLY_MAX)
+    telnet_flush(session);
+  session->reply_len += sprintf(&session->reply[session->reply_len], "[PR:Hz:%lu]\r\n", (unsigned long)SystemCoreClock);
+
+  for (id = 0; id < N_PROBES; id++) {
+    cycle_probe_get(id, &stats);
+
+    if (session->reply_len > TELNET_REPLY_SIZE - TELNET_REPLY_MAX)
+      telnet_flush(session);
+
+    reply = &session->reply[session->reply_len];
+    reply += sprintf(reply, "[PR:%s|N:%lu|Min:%lu|Max:%lu|Mean:%lu|H:", cycle_probe_name(id),
+                     (unsigned long)stats.count, (unsigned long)stats.min, (unsigned long)stats.max,
+                     (unsigned long)(stats.count ? stats.total / stats.count : 0));
+    for (bin = 0; bin < PROBE_BINS; bin++)
+      reply += sprintf(reply, bin ? ",%lu" : "%lu", (unsigned long)stats.histogram[bin]);
+    reply += sprintf(reply, "]\r\n");
+    session->reply_len = reply - session->reply;
+  }
+
+  if (len == 4)
+    cycle_probe_reset();
+
+  return true;
+}
+#else
+#define telnet_probes(session, data, len) false
+#endif
+/*-----------------------------------------------------------------------------------*/
+static void
+telnet_line(const char *data, uint16_t len, bool overflow, void *context)
+{
+  extern MessageBufferHandle_t xInBuffer;
+  telnet_session_t *session = (telnet_session_t *)context;
+  status_code_t status = Status_LineLengthExceeded;
+  gc_line_t line;
+
+  line.seq = next_seq++;
+
+  // Answered here, the parser never sees it
+  if (!overflow && (telnet_stats(session, data, len) || telnet_probes(session, data, len))) {
+    telnet_reply(session, line.seq, Status_OK);
+    return;
+  }
+
+  // Tokenize straight from the received segment, no intermediate string copies
+  if (!overflow)
+    status = gc_scan_line(data, len, &line);
+
+  // Send GCode to parser, it acknowledges the line when it has been planned.
+  // Only the words present are copied. If the buffer is full, wait for place in buffer
+  // before sending but keep passing acks on so that the parser does not stall on them.
+  if (status == Status_OK && (line.n_words || line.program_demarcation))
+  {
+    session->outstanding++;
+    while (xMessageBufferSend(xInBuffer, &line, GC_LINE_SIZE(line.n_words), pdMS_TO_TICKS(TELNET_ACK_POLL_MS)) == 0)
+    {
+      telnet_collect_acks(session);
+      telnet_flush(session);
+    }
+  }
+  else
+  {
+    // Errors, empty and comment lines are acknowledged here, also for host syncing
+    telnet_reply(session, line.seq, status);
+  }
+}
 /*-----------------------------------------------------------------------------------*/
 static void
 telnet_thread(void *arg)
 {
-  extern QueueHandle_t xInQueue;
   struct netconn *conn, *newconn;
   err_t err;
 
@@ -64,6 +311,9 @@ telnet_thread(void *arg)
 
   LWIP_ERROR("telnet: invalid conn", (conn != NULL), return;);
 
+  // Feed hold, cycle start and overrides act as they arrive, not after the lines before them
+  session.framer.realtime = protocol_enqueue_realtime_command;
+
   /* Tell connection to go into listening mode. */
   netconn_listen(conn);
 
@@ -74,42 +324,56 @@ telnet_thread(void *arg)
     /* Process the new connection. */
     if (err == ERR_OK) {
       struct netbuf *buf;
+      stepper_stats_t stats;
       void *data;
       u16_t len;
-      char outbuff[50];
-      char okText[] = "ok\r\n";
-      uint32_t x;
-
-      while ((err = netconn_recv(newconn, &buf)) == ERR_OK)
-      {
-        //printf("Recved\n");
-        do
-        {
-             netbuf_data(buf, &data, &len);
-            // Compress instring and sen
-            compressInstring(data, &len, &outbuff);
-
-//			printf("%s", outbuff);
-//			printf("\r\n");
 
-			// Send GCode to planner
-            // If buffer is full, wait for place in buffer before sending
-			if(len > 0)
-			{
-				xQueueSendToBack(xInQueue, &outbuff,  portMAX_DELAY );
-			}
+      session.conn = newconn;
+      session.first_seq = next_seq;
+      session.outstanding = 0;
+      line_framer_reset(&session.framer);
 
-			// Wait for move complete (M400)
+      // Only underruns from here on are reported
+      stepper_get_stats(&stats);
+      session.underruns = telnet_underruns(&stats);
 
+      // Advertise the flow control window, see telnet.h
+      session.reply_len = sprintf(session.reply, "[WND:%u,%u|Ln:%lu]\r\n", INPUT_WINDOW_LINES,
+                                  LINE_FRAMER_MAX_LINE, (unsigned long)session.first_seq);
+      err = telnet_flush(&session);
 
-			// Send acknowledge
-			err = netconn_write(newconn, (const unsigned char*) (okText), sizeof(okText), NETCONN_COPY);
+      while (err == ERR_OK)
+      {
+        // Poll for acks while lines are being parsed, for outputs to be switched and for
+        // alarms while the base moves, else just wait for data
+        netconn_set_recvtimeout(newconn, session.outstanding || stepper_outputs_pending() ||
+                                !(xEventGroupGetBits(xMoveReady) & MOVE_READY_BASE) ? TELNET_ACK_POLL_MS : 0);
 
-			//RTOS_HeapLeft();
+        if ((err = netconn_recv(newconn, &buf)) == ERR_OK)
+        {
+          // A segment may hold several lines and a line may continue in the next
+          // segment, let the framer split the pbuf chain into complete lines.
+          do
+          {
+              netbuf_data(buf, &data, &len);
+              line_framer_input(&session.framer, data, len, telnet_line, &session);
+          }
+          while (netbuf_next(buf) >= 0);
+          netbuf_delete(buf);
+        }
+        else if (err == ERR_TIMEOUT)
+          err = ERR_OK;
 
+        if (err == ERR_OK)
+        {
+          telnet_collect_acks(&session);
+          telnet_collect_outputs(&session);
+          telnet_collect_underruns(&session);
+          telnet_collect_alarm(&session);
+          err = telnet_flush(&session);
         }
-        while (netbuf_next(buf) >= 0);
-        netbuf_delete(buf);
+
+        //RTOS_HeapLeft();
       }
       printf("Got EOF, looping\n");
       /* Close connection and discard connection identifier. */
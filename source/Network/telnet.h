@@ -8,6 +8,60 @@
 #ifndef NETWORK_TELNET_H_
 #define NETWORK_TELNET_H_
 
+/*
+ * Flow control on the g-code port (23)
+ *
+ * On connect the controller sends
+ *
+ *   [WND:<window>,<max line length>|Ln:<first seq>]
+ *
+ * Every received line, including empty and comment lines, is given the next sequence
+ * number and is answered exactly once, after it has been parsed and queued for the planner:
+ *
+ *   ok|Ln:<seq>|Bf:<planner free>,<input free>
+ *   error:<code>|Ln:<seq>|Bf:<planner free>,<input free>
+ *
+ * The host may keep up to <window> lines unacknowledged instead of waiting for each ok,
+ * Bf: reports the free blocks in the planner queue and the free bytes in the input buffer.
+ * Answers may be sent out of order, use Ln: to match them to lines.
+ *
+ * Base outputs switched along a move (M62/M63 P0-49 Q<mm>) are reported when the step ISR
+ * switches them, with the X and Y position in steps at that step event:
+ *
+ *   [OUT:<port>,<value>|Pos:<x>,<y>]
+ *
+ * $ST is answered with the step buffer statistics, $STR also resets them. Fill levels are
+ * segments queued, low water marks are taken when a segment is started that must be followed
+ * by another one. Under: counts each axis running out of segments while moving, Near: the
+ * starts of a last queued segment mid-motion, which get settings.underrun_response:
+ *
+ *   [ST:Seg:<low>,<high>|Async:<x low>,<x high>,<y low>,<y high>|Under:<x>,<y>|Near:<n>]
+ *
+ * New underruns are reported as they are counted, with the counts since the last $STR:
+ *
+ *   [UNDERRUN:<x>,<y>|Near:<n>]
+ *
+ * With CYCLE_PROBES in config.h $PR is answered with the cycle probes, $PRR also resets them.
+ * Cycles are counted at the core clock given first. Each probe reports its runs, min, max and
+ * mean cycles and a histogram, bin 0 below 64 cycles and bin n from 2^(n + 5), the last bin
+ * open ended:
+ *
+ *   [PR:Hz:<core clock>]
+ *   [PR:<probe>|N:<runs>|Min:<cycles>|Max:<cycles>|Mean:<cycles>|H:<bin 0>,...,<bin 15>]
+ *
+ * An alarm raised by the step ISR, such as 14 for an underrun, is reported once as
+ *
+ *   ALARM:<code>
+ *
+ * Realtime commands are taken out of the stream as they arrive, also in the middle of a
+ * line, and are not acknowledged: '!' feed hold, '~' cycle start, 0x90-0x94 feed override
+ * (reset, +10%, -10%, +1%, -1%). They are not counted as lines.
+ */
 
+// Acknowledge posted by the parser thread for a queued line, sent to the host by telnet
+typedef struct {
+    uint32_t seq;
+    status_code_t status;
+} line_ack_t;
 
 #endif /* NETWORK_TELNET_H_ */
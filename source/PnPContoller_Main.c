@@ -16,6 +16,7 @@
 #include "lwip/opt.h"
 
 #include "tcpecho.h"
+#include "binary_protocol.h"
 #include "lwip/netifapi.h"
 #include "lwip/tcpip.h"
 #include "netif/ethernet.h"
@@ -90,8 +91,10 @@
 static mdio_handle_t mdioHandle = {.ops = &EXAMPLE_MDIO_OPS};
 static phy_handle_t phyHandle   = {.phyAddr = EXAMPLE_PHY_ADDRESS, .mdioHandle = &mdioHandle, .ops = &EXAMPLE_PHY_OPS};
 /* Declared globally. */
-QueueHandle_t xInQueue = NULL;
+MessageBufferHandle_t xInBuffer = NULL;
 QueueHandle_t xPlannerQueue = NULL;
+QueueHandle_t xAckQueue = NULL;
+EventGroupHandle_t xMoveReady = NULL;
 
 // Declare system global variable structure
 system_t sys;
@@ -105,10 +108,10 @@ volatile uint_fast16_t sys_rt_exec_alarm;   // Global realtime executor bitflag
 HAL hal;
 
 
-controllerBoard_t BaseController;
-controllerBoard_t HeadController;
-controllerBoard_t Feeder1Controller;
-controllerBoard_t Feeder2Controller;
+controllerBoard_t BaseController = { .ReadyBit = MOVE_READY_BASE };
+controllerBoard_t HeadController = { .ReadyBit = MOVE_READY_HEAD };
+controllerBoard_t Feeder1Controller = { .ReadyBit = MOVE_READY_FEEDER1 };
+controllerBoard_t Feeder2Controller = { .ReadyBit = MOVE_READY_FEEDER2 };
 
 
 
@@ -159,6 +162,9 @@ int main(void)
     BOARD_InitDebugConsole();
     BOARD_InitModuleClock();
 
+    // Times the step pulses and the cycle probes
+    cycle_counter_init();
+
     //
     // Init SDRAM
     //
@@ -217,15 +223,19 @@ int main(void)
 
 
 
+    settings_init();
+    sys.override.feed_rate = DEFAULT_FEED_OVERRIDE;
+
+    // All controllers start out idle
+    xMoveReady = xEventGroupCreate();
+    xEventGroupSetBits(xMoveReady, MOVE_READY_ALL);
+
     http_init();
     telnet_init();
+    binary_init();
     gcode_init();
     planner_init();
-
-    BaseController.MoveReady = true;
-    HeadController.MoveReady = true;
-    Feeder1Controller.MoveReady = true;
-    Feeder2Controller.MoveReady = true;
+    stepper_init();
 
     vTaskStartScheduler();
 
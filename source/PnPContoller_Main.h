@@ -19,6 +19,12 @@
 
 #include <assert.h>
 
+// RTOS, network stack and debug console. The g-code core headers do not pull
+// these in themselves so the parser also builds on the host (tools/gcode_bench).
+#include "lwip/opt.h"
+#include "message_buffer.h"
+#include "event_groups.h"
+
 // Define the Grbl system include files. NOTE: Do not alter organization.
 #include "config.h"
 #include "nuts_bolts.h"
@@ -26,6 +32,7 @@
 #include "hal.h"
 #include "system.h"
 #include "defaults.h"
+#include "placement.h"
 
 //#include "coolant_control.h"
 //#include "eeprom.h"
@@ -33,44 +40,89 @@
 #include "gcode.h"
 #include "limits.h"
 #include "planner.h"
+#include "motion_profile.h"
+#include "shaper.h"
 #include "motion_control.h"
-//#include "protocol.h"
+#include "protocol.h"
 //#include "state_machine.h"
 //#include "report.h"
 //#include "spindle_control.h"
-//#include "stepper.h"
+#include "stepper.h"
+#include "cycle_probe.h"
 //#include "system.h"
 //#include "override.h"
 //#include "sleep.h"
 //#include "stream.h"
 
+// Feed hold and feed override followed by one step stream, the coordinated segments or an
+// async axis. Applied by the step ISR on top of the planned periods.
+typedef struct {
+	uint32_t Ticks;					// Period last handed out
+	uint32_t Ramp;					// Period of the ramp to a new override or to rest
+	int32_t  RampIndex;				// Recurrence index of the ramp, 0 when not ramping
+	uint32_t RestTicks;				// First period from rest at the hold acceleration
+	uint32_t Scale;					// Override followed, period multiplier in 8.8 fixed point
+	bool     Hold;					// Feed hold followed
+	bool     Stopped;				// Hold ramp has come to rest
+} governor_t;
+
 // Axis structure
 typedef struct {
-	GPIO_Type* GPIO;				// GPIO for axis
-	uint32_t StepPin;
-	uint32_t DirPin;
-	uint32_t EnablePin;
 	uint32_t ActualPos;  			// Actual position
 	uint32_t TargetPos;				// Target position
-	uint32_t CruiseStepsLeft;		// Number of steps left for cruise speed
-	bool     Cruising;
+	uint32_t SegmentSteps;			// Steps of this axis in the segment being stepped
+	uint32_t Counter;				// Bresenham counter against the segment step events
+	uint32_t NextTime;				// Async: timer time of next event
+	uint32_t Ticks;					// Async: current period
+#ifdef STEP_TIMING_RECURRENCE
+	int32_t  RampIndex;				// Async: recurrence index of next step
+#else
+	int32_t  TicksDelta;			// Async: added to Ticks after each step
+#endif
+	uint32_t StepsLeft;				// Async: steps left in segment
+	bool     Starved;				// Async: next event only polls for a late segment
+	bool     EndAtRest;				// Async: segment being stepped ends at rest
+	bool     Held;					// Async: next event only polls for the end of a feed hold
+	governor_t Governor;			// Async: feed hold and override
 	bool	 DirectionForward;		// Direction of move
-    bool	 moveReady;				// Signal that axis move is ready
     uint8_t  AxisNum;
 } axis_t;
 
 
-// Circular buffer for steppers
+// Circular buffer for steppers, a run of step events at a constant period, or an accelerating
+// or decelerating one continued by the recurrence or linearly
 typedef struct {
-    uint32_t ticks;         		// Number of ticks delay
-    uint16_t SegmentSteps;  		// Number of steps for segment
+    uint32_t ticks;         		// Number of ticks delay before first step event, 24.8 fixed point with recurrence
+#ifdef STEP_TIMING_RECURRENCE
+    int32_t  RampIndex;				// Recurrence index of the next step event, < 0 decelerating, 0 for constant rate
+#else
+    int32_t  TicksDelta;    		// Added to ticks after each step event, 0 for constant rate
+#endif
+    uint16_t SegmentSteps;  		// Number of step events for segment, dominant axis steps
+    uint16_t AxisSteps[N_BASE_AXIS];	// Steps of each axis within the segment
+    uint8_t  DirectionBits; 		// Bit set for axes moving forward, SEGMENT_END_AT_REST
+    uint8_t  Outputs;				// Output events switched with the first step event
 } stepper_buffer_t;
 
+#define SEGMENT_END_AT_REST		bit(7)		// In DirectionBits, the stream may run dry after this segment
+
+// Move completion bits in xMoveReady, set while a controller or base axis has nothing left to move.
+// The base and its axes are set from the step ISR, the other controllers when they report back.
+#define MOVE_READY_BASE			bit(0)
+#define MOVE_READY_HEAD			bit(1)
+#define MOVE_READY_FEEDER1		bit(2)
+#define MOVE_READY_FEEDER2		bit(3)
+#define MOVE_READY_AXIS(idx)	(1UL << (4 + (idx)))	// Base axis idx
+#define MOVE_READY_BASE_AXES	(((1 << N_BASE_AXIS) - 1) << 4)
+#define MOVE_READY_ALL			(MOVE_READY_BASE | MOVE_READY_HEAD | MOVE_READY_FEEDER1 | MOVE_READY_FEEDER2 | MOVE_READY_BASE_AXES)
+
 // Controller signals
 typedef struct {
-    bool MoveReady;         		// Signal that move is ready to sync controllers
+    EventBits_t ReadyBit;			// Bit in xMoveReady set when its moves are done
 } controllerBoard_t;
 
+extern EventGroupHandle_t xMoveReady;
+
 
 
 extern controllerBoard_t BaseController;
@@ -0,0 +1,36 @@
+/*
+ * placement.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Memory placement of the step ISR and what it runs on. XIP flash has wait states and the
+ *  caches miss at the start of a move, the tightly coupled memories run at core speed.
+ *
+ *  HOT_CODE   ITCM, input section CodeQuickAccess
+ *  HOT_DATA   DTCM, input section DataQuickAccess
+ *  HOT_CONST  DTCM, input section DataQuickAccess.const, const data can not share a section
+ *             with writable data
+ *
+ *  The input sections are mapped by the "Extra linker script input sections" of the managed
+ *  linker script, as type .data so they are copied from flash at startup. After the link
+ *  tools/placement_report/placement_report.py lists where every marked symbol landed and
+ *  fails the build if one ended up outside its TCM or is not found in the image. A marked
+ *  function inlined into its caller goes with the caller. Host builds keep the default
+ *  sections.
+ */
+
+#ifndef PLACEMENT_H_
+#define PLACEMENT_H_
+
+#if defined(__arm__) && defined(__GNUC__)
+#define HOT_CODE __attribute__((section("CodeQuickAccess")))
+#define HOT_DATA __attribute__((section("DataQuickAccess")))
+#define HOT_CONST __attribute__((section("DataQuickAccess.const")))
+#else
+#define HOT_CODE
+#define HOT_DATA
+#define HOT_CONST
+#endif
+
+#endif /* PLACEMENT_H_ */
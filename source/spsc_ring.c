@@ -0,0 +1,46 @@
+/*
+ * spsc_ring.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ */
+
+#include <string.h>
+
+#include "spsc_ring.h"
+
+bool spsc_ring_init(spsc_ring_t *ring, void *buffer, uint32_t capacity, uint32_t elem_size)
+{
+	if(capacity == 0 || (capacity & (capacity - 1)))
+		return false;
+
+	ring->buffer = buffer;
+	ring->mask = capacity - 1;
+	ring->elem_size = elem_size;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+
+	return true;
+}
+
+uint32_t spsc_ring_put_bulk(spsc_ring_t *ring, const void *elems, uint32_t n)
+{
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint32_t free = ring->mask + 1 - (head - atomic_load_explicit(&ring->tail, memory_order_acquire));
+	uint32_t idx = head & ring->mask, first;
+
+	if(n > free)
+		n = free;
+
+	// At most two copies, up to the end of storage and the rest from the start
+	first = ring->mask + 1 - idx;
+	if(first > n)
+		first = n;
+
+	memcpy(ring->buffer + idx * ring->elem_size, elems, first * ring->elem_size);
+	memcpy(ring->buffer, (const uint8_t *)elems + first * ring->elem_size, (n - first) * ring->elem_size);
+
+	atomic_store_explicit(&ring->head, head + n, memory_order_release);
+
+	return n;
+}
@@ -0,0 +1,100 @@
+/*
+ * spsc_ring.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Lock-free single producer, single consumer ring, safe between a task and an ISR.
+ *  The producer only writes head and the consumer only writes tail, both are free running
+ *  and wrapped with a mask so capacity must be a power of two. Publishing uses release
+ *  stores and observing the other side uses acquire loads, on the Cortex-M7 these become
+ *  DMB barriers so slot contents are visible before the index that hands them over.
+ *  Nothing is asserted or allocated, all calls are usable from an ISR. The inline calls are
+ *  placed with the step ISR when they are not inlined.
+ */
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "placement.h"
+
+typedef struct {
+	_Atomic uint32_t head;		// Next slot to write, written by producer only
+	_Atomic uint32_t tail;		// Next slot to read, written by consumer only
+	uint32_t mask;				// Capacity - 1
+	uint32_t elem_size;
+	uint8_t *buffer;
+} spsc_ring_t;
+
+// Set up ring on a storage buffer of capacity elements of elem_size bytes
+// Returns false if capacity is not a power of two
+bool spsc_ring_init(spsc_ring_t *ring, void *buffer, uint32_t capacity, uint32_t elem_size);
+
+// Copy up to n elements in and publish them at once
+// Producer side. Returns the number of elements added
+uint32_t spsc_ring_put_bulk(spsc_ring_t *ring, const void *elems, uint32_t n);
+
+//
+// Number of elements queued. The other side may move on while it is read: from the consumer
+// side it is a lower bound, the producer may have added more, from the producer side an upper
+// bound, the consumer may have taken more. Only call it from one of the two sides, anywhere
+// else tail may have passed the head read and the count wraps
+static inline HOT_CODE uint32_t spsc_ring_count(spsc_ring_t *ring)
+{
+	return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+//
+// Number of free slots, a lower bound from the producer side
+static inline uint32_t spsc_ring_free(spsc_ring_t *ring)
+{
+	return ring->mask + 1 - spsc_ring_count(ring);
+}
+
+//
+// Next free slot to fill in place, NULL if full. Not visible to the consumer until committed
+// Producer side
+static inline HOT_CODE void *spsc_ring_reserve(spsc_ring_t *ring)
+{
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+	if(head - atomic_load_explicit(&ring->tail, memory_order_acquire) > ring->mask)
+		return NULL;
+
+	return ring->buffer + (head & ring->mask) * ring->elem_size;
+}
+
+//
+// Publish the slot returned by spsc_ring_reserve
+// Producer side
+static inline HOT_CODE void spsc_ring_commit(spsc_ring_t *ring)
+{
+	atomic_store_explicit(&ring->head, atomic_load_explicit(&ring->head, memory_order_relaxed) + 1, memory_order_release);
+}
+
+//
+// Oldest element, NULL if empty. Stays valid until released
+// Consumer side
+static inline HOT_CODE void *spsc_ring_peek(spsc_ring_t *ring)
+{
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+	if(tail == atomic_load_explicit(&ring->head, memory_order_acquire))
+		return NULL;
+
+	return ring->buffer + (tail & ring->mask) * ring->elem_size;
+}
+
+//
+// Hand the slot returned by spsc_ring_peek back to the producer
+// Consumer side
+static inline HOT_CODE void spsc_ring_release(spsc_ring_t *ring)
+{
+	atomic_store_explicit(&ring->tail, atomic_load_explicit(&ring->tail, memory_order_relaxed) + 1, memory_order_release);
+}
+
+#endif /* SPSC_RING_H_ */
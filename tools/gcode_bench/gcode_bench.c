@@ -0,0 +1,246 @@
+/*
+ * gcode_bench.c
+ *
+ *  Host benchmark for the g-code core (gc_scan_line + parseTokens).
+ *
+ *  Streams one or more g-code files, or a generated pick-and-place corpus, through the
+ *  parser and reports lines/sec, ns/line and heap allocations. Parsed blocks end up in a
+ *  counting sink instead of the planner queue.
+ *
+ *  Build (from the repository root):
+ *
+ *    gcc -O2 -Isource/GCode -o gcode_bench tools/gcode_bench/gcode_bench.c \
+ *        source/GCode/GCode.c source/GCode/nuts_bolts.c -lm \
+ *        -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+ *
+ *  With -DCYCLE_PROBES -Isource -Itools/host source/GCode/cycle_probe.c tools/host/host_sdk.c
+ *  added it also checks that the parseTokens probe counted every line parsed. The host has no
+ *  cycle counter, the cycles come out 0.
+ *
+ *  Usage:
+ *
+ *    gcode_bench [-r repeats] [-g lines] [file ...]
+ *
+ *    -r  number of passes over the corpus (default 10)
+ *    -g  size of the generated corpus when no files are given (default 100000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "GCode.h"
+#include "cycle_probe.h"
+
+#define LINE_MAX_LEN 256
+
+typedef struct {
+    char **line;
+    size_t count;
+    size_t size;
+} corpus_t;
+
+static uint64_t allocs, frees;
+static uint64_t blocks;
+
+/*
+ * Allocation counters, hooked in with -Wl,--wrap.
+ */
+
+void *__real_malloc (size_t size);
+void *__real_calloc (size_t n, size_t size);
+void *__real_realloc (void *ptr, size_t size);
+void __real_free (void *ptr);
+
+void *__wrap_malloc (size_t size)
+{
+    allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc (size_t n, size_t size)
+{
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc (void *ptr, size_t size)
+{
+    if(ptr == NULL)
+        allocs++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free (void *ptr)
+{
+    if(ptr)
+        frees++;
+    __real_free(ptr);
+}
+
+static status_code_t count_block (parser_block_t *gc_block)
+{
+    (void)gc_block;
+    blocks++;
+
+    return Status_OK;
+}
+
+static void corpus_add (corpus_t *corpus, const char *line)
+{
+    if(corpus->count == corpus->size) {
+        corpus->size = corpus->size ? corpus->size * 2 : 1024;
+        corpus->line = realloc(corpus->line, corpus->size * sizeof(char *));
+    }
+    corpus->line[corpus->count++] = strdup(line);
+}
+
+static bool corpus_load (corpus_t *corpus, const char *path)
+{
+    char line[LINE_MAX_LEN];
+    FILE *file = strcmp(path, "-") ? fopen(path, "r") : stdin;
+
+    if(file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    while(fgets(line, sizeof(line), file))
+        corpus_add(corpus, line);
+
+    if(file != stdin)
+        fclose(file);
+
+    return true;
+}
+
+static float rnd (uint32_t *seed, float range)
+{
+    *seed = *seed * 1103515245u + 12345u;
+
+    return (float)((*seed >> 8) % 100000u) * range / 100000.0f;
+}
+
+// Typical pick-and-place job: rapid to feeder, pick, rapid to board, rotate, place.
+static void corpus_generate (corpus_t *corpus, size_t lines)
+{
+    char line[LINE_MAX_LEN];
+    uint32_t seed = 12345;
+    size_t n = 0;
+
+    corpus_add(corpus, "G21 G90 G94 (metric, absolute)\n");
+
+    while(n < lines) {
+        uint32_t nozzle = 10 + (n % 4);
+        snprintf(line, sizeof(line), "G0 X%.3f Y%.3f F30000 ; feeder %u\n", rnd(&seed, 400.0f), rnd(&seed, 40.0f), (unsigned)(n % 32));
+        corpus_add(corpus, line);
+        snprintf(line, sizeof(line), "g1 z-12.500 f5000\n");
+        corpus_add(corpus, line);
+        snprintf(line, sizeof(line), "M62 P%u\n", (unsigned)nozzle);
+        corpus_add(corpus, line);
+        snprintf(line, sizeof(line), "G1 Z0 F5000\n");
+        corpus_add(corpus, line);
+        snprintf(line, sizeof(line), "G0 X%.3f Y%.3f A%.2f (place R%u)\n", rnd(&seed, 300.0f) + 50.0f, rnd(&seed, 250.0f) + 60.0f, rnd(&seed, 360.0f), (unsigned)n);
+        corpus_add(corpus, line);
+        snprintf(line, sizeof(line), "G1 Z-11.800 F5000\n");
+        corpus_add(corpus, line);
+        snprintf(line, sizeof(line), "M63 P%u\n", (unsigned)nozzle);
+        corpus_add(corpus, line);
+        snprintf(line, sizeof(line), "G1 Z0 F5000\n");
+        corpus_add(corpus, line);
+        n += 8;
+    }
+}
+
+static double now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+int main (int argc, char **argv)
+{
+    corpus_t corpus = {0};
+    char message[50];
+    gc_line_t line;
+    uint64_t lines = 0, errors = 0, bytes = 0, parsed = 0;
+    unsigned long repeats = 10, generate = 100000;
+    int arg = 1;
+
+    for(; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++) {
+        if(!strcmp(argv[arg], "-r") && arg + 1 < argc)
+            repeats = strtoul(argv[++arg], NULL, 10);
+        else if(!strcmp(argv[arg], "-g") && arg + 1 < argc)
+            generate = strtoul(argv[++arg], NULL, 10);
+        else {
+            fprintf(stderr, "usage: %s [-r repeats] [-g lines] [file ...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if(arg == argc)
+        corpus_generate(&corpus, generate);
+    else for(; arg < argc; arg++) {
+        if(!corpus_load(&corpus, argv[arg]))
+            return 1;
+    }
+
+    if(corpus.count == 0) {
+        fprintf(stderr, "empty corpus\n");
+        return 1;
+    }
+
+    gc_init(true);
+    gc_set_block_sink(count_block);
+
+    uint64_t allocs_start = allocs, frees_start = frees;
+    double start = now_ns();
+
+    for(unsigned long pass = 0; pass < repeats; pass++) {
+        for(size_t i = 0; i < corpus.count; i++) {
+            uint16_t len = (uint16_t)strlen(corpus.line[i]);
+
+            bytes += len;
+            lines++;
+
+            if(gc_scan_line(corpus.line[i], len, &line) != Status_OK)
+                errors++;
+            else if((line.n_words || line.program_demarcation) && (++parsed, parseTokens(&line, message)) != Status_OK)
+                errors++;
+        }
+    }
+
+    double elapsed = now_ns() - start;
+
+    printf("lines        : %llu (%zu x %lu)\n", (unsigned long long)lines, corpus.count, repeats);
+    printf("bytes        : %llu\n", (unsigned long long)bytes);
+    printf("blocks       : %llu\n", (unsigned long long)blocks);
+    printf("errors       : %llu\n", (unsigned long long)errors);
+    printf("time         : %.3f ms\n", elapsed / 1e6);
+    printf("lines/sec    : %.0f\n", (double)lines * 1e9 / elapsed);
+    printf("ns/line      : %.1f\n", elapsed / (double)lines);
+    printf("MB/sec       : %.2f\n", (double)bytes * 1e3 / elapsed);
+    printf("allocations  : %llu (%.3f/line), %llu freed\n", (unsigned long long)(allocs - allocs_start),
+            (double)(allocs - allocs_start) / (double)lines, (unsigned long long)(frees - frees_start));
+
+#ifdef CYCLE_PROBES
+    probe_stats_t probe;
+
+    cycle_probe_get(Probe_ParseTokens, &probe);
+    printf("probe        : %s %lu runs\n", cycle_probe_name(Probe_ParseTokens), (unsigned long)probe.count);
+
+    // Wraps at 2^32 runs
+    if(probe.count != (uint32_t)parsed) {
+        fprintf(stderr, "probe %s counted %lu runs, %llu lines parsed\n", cycle_probe_name(Probe_ParseTokens),
+                (unsigned long)probe.count, (unsigned long long)parsed);
+        return 4;
+    }
+#endif
+
+    return errors ? 3 : 0;
+}
@@ -0,0 +1,10 @@
+/*
+ * FreeRTOS.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Host stand-in, the FreeRTOS calls the firmware sources make are in host_rtos.h.
+ */
+
+#include "host_rtos.h"
@@ -0,0 +1,22 @@
+/*
+ * fsl_common.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Host stand-in for the SDK common header, the macros the firmware sources use.
+ */
+
+#ifndef HOST_FSL_COMMON_H_
+#define HOST_FSL_COMMON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fsl_device_registers.h"
+
+#define USEC_TO_COUNT(us, clockFreqInHz) (uint64_t)(((uint64_t)(us) * (clockFreqInHz)) / 1000000U)
+
+#define AT_NONCACHEABLE_SECTION_ALIGN(var, alignbytes) __attribute__((aligned(alignbytes))) var
+
+#endif /* HOST_FSL_COMMON_H_ */
@@ -0,0 +1,36 @@
+/*
+ * fsl_device_registers.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Host stand-in for the SDK device header, only the core debug registers the firmware
+ *  sources touch. The cycle counter does not run on the host, it reads host_dwt.CYCCNT.
+ */
+
+#ifndef HOST_FSL_DEVICE_REGISTERS_H_
+#define HOST_FSL_DEVICE_REGISTERS_H_
+
+#include <stdint.h>
+
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+	volatile uint32_t LAR;
+} DWT_Type;
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk			(1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk		(1UL << 24)
+
+extern DWT_Type host_dwt;
+extern CoreDebug_Type host_core_debug;
+extern uint32_t SystemCoreClock;
+
+#define DWT (&host_dwt)
+#define CoreDebug (&host_core_debug)
+
+#endif /* HOST_FSL_DEVICE_REGISTERS_H_ */
@@ -0,0 +1,35 @@
+/*
+ * fsl_gpio.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Host stand-in for the SDK GPIO driver. A port only keeps the last value written to each
+ *  register and DR, a harness clears DR_SET and DR_CLEAR to see what a step event writes.
+ */
+
+#ifndef HOST_FSL_GPIO_H_
+#define HOST_FSL_GPIO_H_
+
+#include "fsl_common.h"
+
+typedef struct {
+	volatile uint32_t DR;
+	volatile uint32_t DR_SET;
+	volatile uint32_t DR_CLEAR;
+} GPIO_Type;
+
+extern GPIO_Type host_gpio[2];
+
+#define GPIO1 (&host_gpio[0])
+#define GPIO2 (&host_gpio[1])
+
+static inline void GPIO_PinWrite(GPIO_Type *base, uint32_t pin, uint8_t output)
+{
+	if(output)
+		base->DR |= 1U << pin;
+	else
+		base->DR &= ~(1U << pin);
+}
+
+#endif /* HOST_FSL_GPIO_H_ */
@@ -0,0 +1,11 @@
+/*
+ * gcode.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  The firmware includes GCode.h also as gcode.h, which only resolves on a case-insensitive
+ *  file system.
+ */
+
+#include "GCode.h"
@@ -0,0 +1,438 @@
+/*
+ * host_rtos.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Scheduler of the host stand-in for FreeRTOS, see host_rtos.h. Needs the step timer
+ *  simulation, build with STEP_TIMER_SIM.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "host_rtos.h"
+#include "step_timer.h"
+
+#define TASKS_MAX 16
+#define TASK_STACK_SIZE (256 * 1024)
+
+struct host_task {
+	ucontext_t context;
+	const char *name;
+	int prio;
+	bool done;
+	bool (*ready)(struct host_task *task);		// Blocked until it returns true, NULL when ready
+	uint64_t timeout;							// Or until this time
+	uint32_t notify;
+	struct {
+		EventGroupHandle_t group;
+		EventBits_t bits;
+		bool all;
+	} event;
+	QueueHandle_t queue;
+	TaskFunction_t function;
+	void *arg;
+};
+
+struct host_event_group {
+	EventBits_t bits;
+};
+
+struct host_queue {
+	uint8_t *items;
+	UBaseType_t length;
+	UBaseType_t size;
+	UBaseType_t head;
+	UBaseType_t count;
+};
+
+static struct host_task tasks[TASKS_MAX];
+static int n_tasks;
+static struct host_task *current;
+static ucontext_t scheduler;
+static int suspended;							// vTaskSuspendAll() nesting
+
+uint64_t host_rtos_now(void)
+{
+	return step_timer_sim_now();
+}
+
+static uint64_t ticks_per_ms(void)
+{
+	return step_timer_clock() / configTICK_RATE_HZ;
+}
+
+static bool task_ready(struct host_task *task)
+{
+	return !task->done && (task->ready == NULL || task->ready(task) || host_rtos_now() >= task->timeout);
+}
+
+//
+// Highest priority ready task, the first created of equal ones
+static struct host_task *highest_ready(void)
+{
+	struct host_task *best = NULL;
+	int idx;
+
+	for(idx = 0; idx < n_tasks; idx++)
+	{
+		if(task_ready(&tasks[idx]) && (best == NULL || tasks[idx].prio > best->prio))
+			best = &tasks[idx];
+	}
+
+	return best;
+}
+
+//
+// Back to the scheduler if a higher priority task is ready
+static void preempt(void)
+{
+	struct host_task *best;
+
+	if(current == NULL || suspended)
+		return;
+
+	if((best = highest_ready()) != NULL && best->prio > current->prio)
+		swapcontext(&current->context, &scheduler);
+}
+
+//
+// Time a call takes, the step ISR runs for the events due by its end
+static void call(void)
+{
+	if(current)
+		step_timer_sim_advance(host_rtos_now() + HOST_RTOS_CALL_TICKS);
+	preempt();
+}
+
+//
+// Block the running task until ready returns true or timeout ticks have passed, false on timeout
+static bool block(bool (*ready)(struct host_task *task), TickType_t timeout)
+{
+	if(ready(current))
+		return true;
+
+	if(timeout == 0)
+		return false;
+
+	if(suspended)
+	{
+		fprintf(stderr, "host_rtos: %s blocks with the scheduler suspended\n", current->name);
+		exit(3);
+	}
+
+	current->ready = ready;
+	current->timeout = timeout == portMAX_DELAY ? UINT64_MAX : host_rtos_now() + timeout * ticks_per_ms();
+	swapcontext(&current->context, &scheduler);
+	current->ready = NULL;
+
+	return ready(current);
+}
+
+static bool never(struct host_task *task)
+{
+	(void)task;
+
+	return false;
+}
+
+static bool notified(struct host_task *task)
+{
+	return task->notify > 0;
+}
+
+static bool event_bits_set(struct host_task *task)
+{
+	EventBits_t set = task->event.group->bits & task->event.bits;
+
+	return task->event.all ? set == task->event.bits : set != 0;
+}
+
+static bool queue_not_empty(struct host_task *task)
+{
+	return task->queue->count > 0;
+}
+
+static bool queue_not_full(struct host_task *task)
+{
+	return task->queue->count < task->queue->length;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return current;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	call();
+	block(never, ticks);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	call();
+
+	return (TickType_t)(host_rtos_now() / ticks_per_ms());
+}
+
+void host_rtos_delay_ticks(uint64_t ticks)
+{
+	current->ready = never;
+	current->timeout = host_rtos_now() + ticks;
+	swapcontext(&current->context, &scheduler);
+	current->ready = NULL;
+}
+
+void vTaskSuspendAll(void)
+{
+	call();
+	suspended++;
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+	suspended--;
+	call();
+
+	return pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout)
+{
+	uint32_t value;
+
+	call();
+	if(!block(notified, timeout))
+		return 0;
+
+	value = current->notify;
+	current->notify = clear ? 0 : value - 1;
+
+	return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	call();
+	task->notify++;
+	preempt();
+
+	return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+	task->notify++;
+	if(woken && current && task->prio > current->prio)
+		*woken = pdTRUE;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+	return calloc(1, sizeof(struct host_event_group));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+	call();
+	group->bits |= bits;
+	preempt();
+
+	return group->bits;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits, BaseType_t *woken)
+{
+	(void)woken;
+
+	group->bits |= bits;
+
+	return pdPASS;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+	EventBits_t was;
+
+	call();
+	was = group->bits;
+	group->bits &= ~bits;
+
+	return was;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+	call();
+
+	return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all, TickType_t timeout)
+{
+	EventBits_t was;
+
+	call();
+	current->event.group = group;
+	current->event.bits = bits;
+	current->event.all = all;
+	was = group->bits;
+	if(block(event_bits_set, timeout))
+	{
+		was = group->bits;
+		if(clear)
+			group->bits &= ~bits;
+	}
+
+	return was;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t size)
+{
+	QueueHandle_t queue = calloc(1, sizeof(struct host_queue));
+
+	queue->items = calloc(length, size);
+	queue->length = length;
+	queue->size = size;
+
+	return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout)
+{
+	call();
+	current->queue = queue;
+	if(!block(queue_not_full, timeout))
+		return pdFAIL;
+
+	memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->size, item, queue->size);
+	queue->count++;
+	preempt();
+
+	return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout)
+{
+	call();
+	current->queue = queue;
+	if(!block(queue_not_empty, timeout))
+		return pdFAIL;
+
+	memcpy(item, queue->items + queue->head * queue->size, queue->size);
+	queue->head = (queue->head + 1) % queue->length;
+	queue->count--;
+	preempt();
+
+	return pdPASS;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+	call();
+
+	return queue->length - queue->count;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+	call();
+
+	return queue->count;
+}
+
+static void task_entry(void)
+{
+	current->function(current->arg);
+	current->done = true;
+	swapcontext(&current->context, &scheduler);
+}
+
+TaskHandle_t sys_thread_new(const char *name, lwip_thread_fn thread, void *arg, int stacksize, int prio)
+{
+	struct host_task *task = &tasks[n_tasks++];
+
+	(void)stacksize;
+
+	if(n_tasks > TASKS_MAX)
+	{
+		fprintf(stderr, "host_rtos: more than %d tasks\n", TASKS_MAX);
+		exit(3);
+	}
+
+	memset(task, 0, sizeof(struct host_task));
+	task->name = name;
+	task->prio = prio;
+	task->function = thread;
+	task->arg = arg;
+	getcontext(&task->context);
+	task->context.uc_stack.ss_sp = malloc(TASK_STACK_SIZE);
+	task->context.uc_stack.ss_size = TASK_STACK_SIZE;
+	task->context.uc_link = NULL;
+	makecontext(&task->context, task_entry, 0);
+
+	if(current)
+		preempt();
+
+	return task;
+}
+
+void host_rtos_irq_disable(void)
+{
+	step_timer_irq_disable();
+}
+
+void host_rtos_irq_enable(void)
+{
+	step_timer_irq_enable();
+}
+
+const char *host_rtos_task_name(void)
+{
+	return current ? current->name : NULL;
+}
+
+bool host_rtos_run(uint64_t until)
+{
+	struct host_task *task;
+	uint64_t next;
+	bool blocked;
+	int idx;
+
+	for(;;)
+	{
+		if((task = highest_ready()) != NULL)
+		{
+			current = task;
+			swapcontext(&scheduler, &task->context);
+			current = NULL;
+			continue;
+		}
+
+		// Every task blocked, on to the next step event or timeout
+		next = step_timer_sim_next();
+		blocked = false;
+		for(idx = 0; idx < n_tasks; idx++)
+		{
+			if(!tasks[idx].done && tasks[idx].ready)
+			{
+				blocked = true;
+				if(tasks[idx].timeout < next)
+					next = tasks[idx].timeout;
+			}
+		}
+
+		if(next == UINT64_MAX)
+			return !blocked;
+		if(next > until)
+		{
+			step_timer_sim_advance(until);
+			return true;
+		}
+
+		step_timer_sim_advance(next);
+	}
+}
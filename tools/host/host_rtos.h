@@ -0,0 +1,101 @@
+/*
+ * host_rtos.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Host stand-in for the FreeRTOS and lwIP calls of the firmware sources, on one simulated
+ *  core. Tasks are ucontext coroutines switched by priority, the highest ready task runs.
+ *  Time is the time of the step timer simulation (step_timer.c, STEP_TIMER_SIM), in its
+ *  ticks. Code takes no time, except that every call made here from a task first moves time
+ *  on by HOST_RTOS_CALL_TICKS and runs the step ISR for the events due by then, the task is
+ *  preempted there if that readied a higher priority task. With every task blocked time
+ *  jumps to the next timer event or timeout.
+ *
+ *  xEventGroupSetBitsFromISR() sets the bits right away instead of through the timer
+ *  service task. Only the calls the firmware sources make are here.
+ */
+
+#ifndef HOST_RTOS_H_
+#define HOST_RTOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t EventBits_t;
+typedef struct host_task *TaskHandle_t;
+typedef struct host_queue *QueueHandle_t;
+typedef struct host_event_group *EventGroupHandle_t;
+typedef struct host_queue *MessageBufferHandle_t;
+typedef void (*TaskFunction_t)(void *);
+typedef void (*lwip_thread_fn)(void *);
+
+#define pdFALSE							((BaseType_t)0)
+#define pdTRUE							((BaseType_t)1)
+#define pdFAIL							pdFALSE
+#define pdPASS							pdTRUE
+#define portMAX_DELAY					((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ				1000
+#define pdMS_TO_TICKS(ms)				((TickType_t)(ms))
+#define configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY 2
+
+// Step timer ticks a call takes
+#ifndef HOST_RTOS_CALL_TICKS
+#define HOST_RTOS_CALL_TICKS			66
+#endif
+
+#define PRINTF printf
+
+// Tasks
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+void vTaskSuspendAll(void);
+BaseType_t xTaskResumeAll(void);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+#define taskENTER_CRITICAL() host_rtos_irq_disable()
+#define taskEXIT_CRITICAL() host_rtos_irq_enable()
+
+// Event groups
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits, BaseType_t *woken);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all, TickType_t timeout);
+
+// Queues
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+#define xQueueSendToBack xQueueSend
+
+// lwIP threads, the stack size is ignored
+TaskHandle_t sys_thread_new(const char *name, lwip_thread_fn thread, void *arg, int stacksize, int prio);
+#define LWIP_UNUSED_ARG(x) (void)x
+
+// Step interrupt masking, used by step_timer.c
+void host_rtos_irq_disable(void);
+void host_rtos_irq_enable(void);
+
+// Runs the tasks until time, or until all of them are done or blocked with no timer event or
+// timeout to wait for. Returns false if tasks are left blocked forever.
+bool host_rtos_run(uint64_t until);
+
+// Simulated time in step timer ticks, and waiting a number of them in a task
+uint64_t host_rtos_now(void);
+void host_rtos_delay_ticks(uint64_t ticks);
+
+// Name of the running task, NULL outside the tasks
+const char *host_rtos_task_name(void);
+
+#endif /* HOST_RTOS_H_ */
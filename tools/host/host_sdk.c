@@ -0,0 +1,18 @@
+/*
+ * host_sdk.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Registers of the host stand-ins in this directory.
+ */
+
+#include "fsl_device_registers.h"
+#include "fsl_gpio.h"
+
+DWT_Type host_dwt;
+CoreDebug_Type host_core_debug;
+GPIO_Type host_gpio[2];
+
+// 0 makes the step pulse width 0 cycles, the host cycle counter does not run
+uint32_t SystemCoreClock;
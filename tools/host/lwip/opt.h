@@ -0,0 +1,11 @@
+/*
+ * opt.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Host stand-in, the lwIP and debug console calls the firmware sources make are in
+ *  host_rtos.h.
+ */
+
+#include "host_rtos.h"
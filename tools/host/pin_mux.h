@@ -0,0 +1,21 @@
+/*
+ * pin_mux.h
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Host stand-in for the pins of board/pin_mux.h the firmware sources use. Step and direction
+ *  are on separate ports so a step event writes each port once.
+ */
+
+#ifndef HOST_PIN_MUX_H_
+#define HOST_PIN_MUX_H_
+
+#include "fsl_gpio.h"
+
+#define BOARD_INITPINS_STEP_X_GPIO		GPIO1
+#define BOARD_INITPINS_STEP_X_GPIO_PIN	18U
+#define BOARD_INITPINS_DIR_X_GPIO		GPIO2
+#define BOARD_INITPINS_DIR_X_GPIO_PIN	4U
+
+#endif /* HOST_PIN_MUX_H_ */
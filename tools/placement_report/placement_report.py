@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# placement_report.py
+#
+#  Created on: 17 okt. 2026
+#      Author: perra
+#
+# Lists the memory every symbol marked HOT_CODE, HOT_DATA or HOT_CONST (source/placement.h)
+# landed in after the link, and fails if one is outside its tightly coupled memory. Run as
+# post-build step from the build directory:
+#
+#   python3 ../tools/placement_report/placement_report.py PnPController_Main.axf . \
+#       -o PnPController_Main.placement
+#
+# The marked symbols are taken from the objects, by their input section, and looked up in
+# the symbol table of the image. Static symbols are matched on the source file they follow
+# in the symbol table. A marked function inlined at all its calls has no symbol in the
+# objects and is not listed, it runs from where its callers are. A marked symbol of the
+# objects that is not found in the image, renamed, discarded or merged by the linker, fails
+# the report like a misplaced one, where it ended up is not known.
+
+import argparse
+import os
+import subprocess
+import sys
+
+# Memory map of the managed linker script, .cproject
+REGIONS = [
+    ("SRAM_ITC", 0x00000000, 0x20000),
+    ("SRAM_DTC", 0x20000000, 0x20000),
+    ("SRAM_OC", 0x20200000, 0xc0000),
+    ("BOARD_FLASH", 0x60000000, 0x400000),
+    ("BOARD_SDRAM", 0x80000000, 0x1e00000),
+]
+
+# Input section of the marked symbols and the region it must end up in
+HOT_SECTIONS = {
+    "CodeQuickAccess": "SRAM_ITC",
+    "DataQuickAccess": "SRAM_DTC",
+    "DataQuickAccess.const": "SRAM_DTC",
+}
+
+
+def region_of(address):
+    for name, start, size in REGIONS:
+        if start <= address < start + size:
+            return name
+    return "unmapped"
+
+
+def run(tool, *args):
+    return subprocess.run([tool] + list(args), check=True, capture_output=True, text=True).stdout
+
+
+def marked_symbols(objdump, objects):
+    """(source file, symbol) -> input section of every marked symbol, globals have no source file"""
+    marked = {}
+    for path in objects:
+        source = None
+        for line in run(objdump, "-t", path).splitlines():
+            # 00000000 l     F CodeQuickAccess	0000007c loadSegment
+            if "\t" not in line:
+                continue
+            flags, _, rest = line.partition("\t")
+            fields = flags.split()
+            size_name = rest.split(None, 1)
+            if len(fields) < 3 or len(size_name) < 2:
+                continue
+            section, name = fields[-1], size_name[1].strip()
+            if section == "*ABS*" and "df" in flags:
+                source = name
+            elif section in HOT_SECTIONS and ("F" in fields[1:-1] or "O" in fields[1:-1]):
+                bind_global = flags[len(fields[0]) + 1] == "g"
+                marked[(None if bind_global else source, name)] = section
+    return marked
+
+
+def image_symbols(readelf, image):
+    """(source file, symbol) -> (address, size), globals have no source file"""
+    symbols = {}
+    source = None
+    for line in run(readelf, "-sW", image).splitlines():
+        # Num: Value Size Type Bind Vis Ndx Name
+        fields = line.split()
+        if len(fields) < 8 or not fields[0].endswith(":"):
+            continue
+        value, size, kind, bind, ndx, name = fields[1], fields[2], fields[3], fields[4], fields[6], fields[7]
+        if kind == "FILE":
+            source = name
+        elif ndx != "UND" and kind in ("FUNC", "OBJECT"):
+            address = int(value, 16) & ~1 if kind == "FUNC" else int(value, 16)
+            symbols[(source if bind == "LOCAL" else None, name)] = (address, int(size, 0))
+    return symbols
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Placement of the HOT_ symbols after the link")
+    parser.add_argument("image", help="linked image, .axf")
+    parser.add_argument("objects", help="directory searched for the objects of the image")
+    parser.add_argument("-o", "--output", help="write the report here instead of stdout")
+    parser.add_argument("--prefix", default="arm-none-eabi-", help="toolchain prefix")
+    args = parser.parse_args()
+
+    objects = [os.path.join(root, name)
+               for root, _, names in os.walk(args.objects)
+               for name in sorted(names) if name.endswith(".o")]
+
+    marked = marked_symbols(args.prefix + "objdump", objects)
+    symbols = image_symbols(args.prefix + "readelf", args.image)
+
+    rows = []
+    misplaced = 0
+    missing = []
+    for (source, name), section in sorted(marked.items(), key=lambda m: (m[1], m[0][1])):
+        if (source, name) not in symbols:
+            missing.append((name, source or "", section))
+            continue
+        address, size = symbols[(source, name)]
+        region = region_of(address)
+        ok = region == HOT_SECTIONS[section]
+        misplaced += not ok
+        rows.append((region, address, size, name, source or "", "" if ok else "MISPLACED"))
+
+    lines = ["Placement of the hot symbols in %s" % args.image, ""]
+    for region, _, _ in REGIONS + [("unmapped", 0, 0)]:
+        placed = [row for row in rows if row[0] == region]
+        if not placed:
+            continue
+        lines.append("%s, %d symbols, %d bytes" % (region, len(placed), sum(row[2] for row in placed)))
+        for _, address, size, name, source, flag in sorted(placed, key=lambda row: row[1]):
+            lines.append("  0x%08x %6d  %-32s %-20s %s" % (address, size, name, source, flag))
+        lines.append("")
+
+    if missing:
+        lines.append("Not found in the image, %d symbols" % len(missing))
+        for name, source, section in missing:
+            lines.append("  %-43s %-20s %s" % (name, source, section))
+        lines.append("")
+
+    if misplaced:
+        lines.append("error: %d hot symbols are outside their tightly coupled memory" % misplaced)
+    if missing:
+        lines.append("error: %d hot symbols of the objects are not in the image" % len(missing))
+
+    failed = misplaced or missing
+
+    report = "\n".join(lines) + "\n"
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(report)
+    sys.stdout.write(report if failed or not args.output else "")
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,253 @@
+/*
+ * profile_sim.c
+ *
+ *  Host simulator for the step streams of the motion profiles (motion_profile.c).
+ *
+ *  Builds the step stream of a point to point move the way the stepper does, exact periods
+ *  for the trapezoid and constant period segments for the jerk limited S-curve, and checks
+ *  the S-curve stream against the analytic profile. Both streams then drive a damped
+ *  resonance to show how long the axis rings after the move.
+ *
+ *  Build (from the repository root):
+ *
+ *    gcc -O2 -Isource/GCode -o profile_sim tools/profile_sim/profile_sim.c \
+ *        source/GCode/motion_profile.c -lm
+ *
+ *  Usage:
+ *
+ *    profile_sim [-d mm] [-s steps/mm] [-v mm/min] [-a mm/s^2] [-j mm/s^3] [-u us]
+ *                [-f Hz] [-z ratio] [-t mm] [-o file]
+ *
+ *    -d  move length (default 5)
+ *    -s  steps per mm (default 400)
+ *    -v  max rate (default 6000)
+ *    -a  acceleration (default 2000)
+ *    -j  jerk (default acceleration times the resonance, the ramp lasts one period of it)
+ *    -u  S-curve segment length (default 500)
+ *    -f  resonance of the axis (default 40)
+ *    -z  damping ratio of the resonance (default 0.05)
+ *    -t  settle tolerance (default 0.005)
+ *    -o  write both streams as csv, time in sec and position in steps
+ *
+ *  Exit status is 1 if a stream misses steps or strays from its profile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "motion_profile.h"
+
+#define TIMER_CLOCK 66000000
+#define SIM_STEP 1e-5           // Resonance integration step, sec
+
+typedef struct {
+    const char *name;
+    uint64_t *tick;             // Timer time of each step
+    uint32_t steps;
+    double max_error;           // Largest distance of a step from its exact time, sec
+    double peak_error;          // Largest following error of the resonance during the move, mm
+    double settle;              // Time after the end of the move until it stays within tolerance, sec
+    double residual;            // Largest following error after the end of the move, mm
+} stream_t;
+
+static double (*exact_time)(uint32_t step);
+static motion_profile_t trapezoid;
+static scurve_profile_t scurve;
+
+static double trapezoid_time(uint32_t step)
+{
+    return profile_time(&trapezoid, step);
+}
+
+static double scurve_exact_time(uint32_t step)
+{
+    return scurve_time(&scurve, step);
+}
+
+static uint64_t *stream_alloc(uint32_t steps)
+{
+    uint64_t *tick = malloc((steps + 1) * sizeof(uint64_t));
+
+    if(tick == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+
+    return tick;
+}
+
+// Exact period of every step, as the ramps run from the step ISR
+static void trapezoid_stream(stream_t *stream)
+{
+    uint64_t now = 0;
+    uint32_t i;
+
+    stream->tick = stream_alloc(trapezoid.steps);
+    for(i = 0; i < trapezoid.steps; i++)
+        stream->tick[i] = now += profile_ticks(&trapezoid, i, TIMER_CLOCK);
+    stream->steps = trapezoid.steps;
+}
+
+// Constant period segments, as queued by the stepper thread
+static void scurve_stream(stream_t *stream, uint32_t segment_ticks)
+{
+    uint64_t now = 0;
+    uint32_t i = 0, n, ticks;
+
+    stream->tick = stream_alloc(scurve.steps);
+    while(i < scurve.steps)
+    {
+        n = scurve_segment(&scurve, i, segment_ticks, TIMER_CLOCK, &ticks);
+        if(n == 0)
+            break;
+        while(n--)
+            stream->tick[i++] = now += ticks;
+    }
+    stream->steps = i;
+}
+
+// Drive a damped resonance with the commanded position, x'' = w^2 (u - x) - 2 z w x'
+static void resonate(stream_t *stream, double mm_per_step, double hz, double zeta, double tolerance)
+{
+    double w = 2.0 * M_PI * hz, x = 0.0, dx = 0.0, u, t, end, error;
+    uint32_t i = 0;
+
+    end = (double)stream->tick[stream->steps - 1] / TIMER_CLOCK;
+    stream->peak_error = stream->residual = stream->settle = 0.0;
+
+    for(t = 0.0; t < end + 1.0; t += SIM_STEP)
+    {
+        while(i < stream->steps && (double)stream->tick[i] / TIMER_CLOCK <= t)
+            i++;
+        u = i * mm_per_step;
+
+        dx += (w * w * (u - x) - 2.0 * zeta * w * dx) * SIM_STEP;
+        x += dx * SIM_STEP;
+
+        error = fabs(u - x);
+        if(t < end)
+            stream->peak_error = fmax(stream->peak_error, error);
+        else
+        {
+            stream->residual = fmax(stream->residual, error);
+            if(error > tolerance)
+                stream->settle = t - end;
+        }
+    }
+}
+
+// Largest distance of a step from the time the profile reaches it
+static void check(stream_t *stream, uint32_t steps)
+{
+    uint32_t i;
+
+    stream->max_error = 0.0;
+    for(i = 0; i < stream->steps; i++)
+        stream->max_error = fmax(stream->max_error, fabs((double)stream->tick[i] / TIMER_CLOCK - exact_time(i + 1)));
+
+    if(stream->steps != steps)
+        fprintf(stderr, "%s: %u of %u steps\n", stream->name, stream->steps, steps);
+}
+
+static void write_csv(const char *file, stream_t *stream, uint_fast8_t count)
+{
+    FILE *f = fopen(file, "w");
+    uint_fast8_t s;
+    uint32_t i;
+
+    if(f == NULL)
+    {
+        perror(file);
+        return;
+    }
+
+    fprintf(f, "profile,time,position\n");
+    for(s = 0; s < count; s++)
+    {
+        for(i = 0; i < stream[s].steps; i++)
+            fprintf(f, "%s,%.7f,%u\n", stream[s].name, (double)stream[s].tick[i] / TIMER_CLOCK, i + 1);
+    }
+    fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+    double distance = 5.0, steps_per_mm = 400.0, rate = 6000.0, accel = 2000.0, jerk = 0.0;
+    double hz = 40.0, zeta = 0.05, tolerance = 0.005, segment_us = 500.0;
+    const char *csv = NULL;
+    stream_t stream[2] = { { .name = "trapezoid" }, { .name = "s-curve" } };
+    uint32_t steps, s;
+    bool failed = false;
+    int opt;
+
+    while((opt = getopt(argc, argv, "d:s:v:a:j:u:f:z:t:o:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'd': distance = atof(optarg); break;
+            case 's': steps_per_mm = atof(optarg); break;
+            case 'v': rate = atof(optarg); break;
+            case 'a': accel = atof(optarg); break;
+            case 'j': jerk = atof(optarg); break;
+            case 'u': segment_us = atof(optarg); break;
+            case 'f': hz = atof(optarg); break;
+            case 'z': zeta = atof(optarg); break;
+            case 't': tolerance = atof(optarg); break;
+            case 'o': csv = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-d mm] [-s steps/mm] [-v mm/min] [-a mm/s^2] [-j mm/s^3] [-u us] [-f Hz] [-z ratio] [-t mm] [-o file]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    // An acceleration ramp of a whole period of the resonance leaves it at rest
+    if(jerk == 0.0)
+        jerk = accel * hz;
+
+    if((steps = (uint32_t)lround(distance * steps_per_mm)) < 2 || rate <= 0.0 || accel <= 0.0 || jerk <= 0.0)
+    {
+        fprintf(stderr, "move needs at least 2 steps and positive rate, acceleration and jerk\n");
+        return 2;
+    }
+
+    profile_calculate(&trapezoid, steps, 0.0f, rate / 60.0 * steps_per_mm, 0.0f, accel * steps_per_mm);
+    scurve_calculate(&scurve, steps, rate / 60.0 * steps_per_mm, accel * steps_per_mm, jerk * steps_per_mm);
+
+    trapezoid_stream(&stream[0]);
+    exact_time = trapezoid_time;
+    check(&stream[0], steps);
+
+    scurve_stream(&stream[1], (uint32_t)(segment_us * 1e-6 * TIMER_CLOCK));
+    exact_time = scurve_exact_time;
+    check(&stream[1], steps);
+
+    printf("move %.3f mm, %u steps, resonance %.1f Hz damping %.3f\n", distance, steps, hz, zeta);
+    printf("s-curve peak rate %.0f mm/min, acceleration %.0f mm/s^2, jerk %.0f mm/s^3\n\n",
+           scurve.cruise_rate / steps_per_mm * 60.0, scurve.acceleration / steps_per_mm, jerk);
+    printf("%-10s %10s %12s %12s %12s %12s\n", "profile", "time ms", "step err us", "peak err um", "residual um", "settle ms");
+
+    for(s = 0; s < 2; s++)
+    {
+        resonate(&stream[s], 1.0 / steps_per_mm, hz, zeta, tolerance);
+        printf("%-10s %10.3f %12.2f %12.2f %12.2f %12.2f\n", stream[s].name,
+               (double)stream[s].tick[stream[s].steps - 1] / TIMER_CLOCK * 1e3, stream[s].max_error * 1e6,
+               stream[s].peak_error * 1e3, stream[s].residual * 1e3, stream[s].settle * 1e3);
+
+        // A step may be off by the segment length at most, otherwise the stream left the profile
+        if(stream[s].steps != steps || stream[s].max_error > segment_us * 1e-6)
+            failed = true;
+    }
+
+    if(csv)
+        write_csv(csv, stream, 2);
+
+    for(s = 0; s < 2; s++)
+        free(stream[s].tick);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * shaper_sim.c
+ *
+ *  Host simulation and benchmark of input shaping (shaper.c).
+ *
+ *  Builds the step stream of a point to point move unshaped and through ZV and ZVD shapers,
+ *  the way the stepper queues it, and drives a damped resonance with each. Reports the added
+ *  move time, the residual vibration after the move and how long it takes to settle, also
+ *  with the shaper tuned off the real resonance. Ends with the cost of building the shaped
+ *  segments.
+ *
+ *  Build (from the repository root):
+ *
+ *    gcc -O2 -Isource/GCode -o shaper_sim tools/shaper_sim/shaper_sim.c \
+ *        source/GCode/shaper.c source/GCode/motion_profile.c -lm
+ *
+ *  Usage:
+ *
+ *    shaper_sim [-d mm] [-s steps/mm] [-v mm/min] [-a mm/s^2] [-j mm/s^3] [-u us]
+ *               [-f Hz] [-z ratio] [-t mm]
+ *
+ *    -d  move length (default 50)
+ *    -s  steps per mm (default 80)
+ *    -v  max rate (default 30000)
+ *    -a  acceleration (default 5000)
+ *    -j  jerk, 0 for a trapezoidal profile (default 0)
+ *    -u  segment length (default 500)
+ *    -f  resonance of the axis, the shapers are tuned to it (default 40)
+ *    -z  damping ratio of the resonance (default 0.1)
+ *    -t  settle tolerance (default 0.01)
+ *
+ *  Exit status is 1 if a stream misses steps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+#include "shaper.h"
+
+#define TIMER_CLOCK 66000000
+#define SIM_STEP 1e-5           // Resonance integration step, sec
+
+typedef struct {
+    double end;                 // Time of the last step, sec
+    double residual;            // Largest following error after the end of the move, mm
+    double settle;              // Time after the end of the move until it stays within tolerance, sec
+} result_t;
+
+static uint64_t *tick;
+
+// Constant period segments, as queued by the stepper thread. Returns the number of steps.
+static uint32_t build_stream(const shaped_move_t *move, uint32_t segment_ticks)
+{
+    uint64_t now = 0;
+    uint32_t i = 0, n, ticks;
+
+    while(i < move->steps)
+    {
+        n = shaper_segment(move, i, segment_ticks, TIMER_CLOCK, &ticks);
+        if(n == 0)
+            break;
+        while(n--)
+            tick[i++] = now += ticks;
+    }
+
+    return i;
+}
+
+// Drive a damped resonance with the commanded position, x'' = w^2 (u - x) - 2 z w x'
+static void resonate(uint32_t steps, double mm_per_step, double hz, double zeta, double tolerance, result_t *result)
+{
+    double w = 2.0 * M_PI * hz, x = 0.0, dx = 0.0, u, t, error;
+    uint32_t i = 0;
+
+    result->end = (double)tick[steps - 1] / TIMER_CLOCK;
+    result->residual = result->settle = 0.0;
+
+    for(t = 0.0; t < result->end + 1.0; t += SIM_STEP)
+    {
+        while(i < steps && (double)tick[i] / TIMER_CLOCK <= t)
+            i++;
+        u = i * mm_per_step;
+
+        dx += (w * w * (u - x) - 2.0 * zeta * w * dx) * SIM_STEP;
+        x += dx * SIM_STEP;
+
+        if(t >= result->end)
+        {
+            error = fabs(u - x);
+            result->residual = fmax(result->residual, error);
+            if(error > tolerance)
+                result->settle = t - result->end;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const char *name[] = { "none", "ZV", "ZVD" };
+    static const double detune[] = { 0.8, 0.9, 1.0, 1.1, 1.2 };
+    double distance = 50.0, steps_per_mm = 80.0, rate = 30000.0, accel = 5000.0, jerk = 0.0;
+    double hz = 40.0, zeta = 0.1, tolerance = 0.01, segment_us = 500.0, unshaped = 0.0, ns;
+    motion_profile_t trapezoid;
+    scurve_profile_t scurve;
+    shaper_t shaper;
+    shaped_move_t move;
+    result_t result;
+    struct timespec t0, t1;
+    uint32_t steps, n, segments;
+    uint_fast8_t type, d;
+    bool failed = false;
+    int opt;
+
+    while((opt = getopt(argc, argv, "d:s:v:a:j:u:f:z:t:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'd': distance = atof(optarg); break;
+            case 's': steps_per_mm = atof(optarg); break;
+            case 'v': rate = atof(optarg); break;
+            case 'a': accel = atof(optarg); break;
+            case 'j': jerk = atof(optarg); break;
+            case 'u': segment_us = atof(optarg); break;
+            case 'f': hz = atof(optarg); break;
+            case 'z': zeta = atof(optarg); break;
+            case 't': tolerance = atof(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-d mm] [-s steps/mm] [-v mm/min] [-a mm/s^2] [-j mm/s^3] [-u us] [-f Hz] [-z ratio] [-t mm]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if((steps = (uint32_t)lround(distance * steps_per_mm)) < 2 || rate <= 0.0 || accel <= 0.0 || jerk < 0.0 || hz <= 0.0)
+    {
+        fprintf(stderr, "move needs at least 2 steps and positive rate, acceleration and resonance\n");
+        return 2;
+    }
+
+    if((tick = malloc(steps * sizeof(uint64_t))) == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+
+    profile_calculate(&trapezoid, steps, 0.0f, rate / 60.0 * steps_per_mm, 0.0f, accel * steps_per_mm);
+    scurve_calculate(&scurve, steps, rate / 60.0 * steps_per_mm, accel * steps_per_mm, jerk * steps_per_mm);
+
+    printf("move %.3f mm, %u steps, %s profile, resonance %.1f Hz damping %.3f\n\n",
+           distance, steps, jerk > 0.0 ? "S-curve" : "trapezoidal", hz, zeta);
+    printf("%-6s %10s %10s %12s %12s\n", "shaper", "time ms", "added ms", "residual um", "settle ms");
+
+    for(type = Shaper_None; type <= Shaper_ZVD; type++)
+    {
+        shaper_init(&shaper, (shaper_type_t)type, hz, zeta);
+        if(jerk > 0.0)
+            shaper_move_scurve(&move, &shaper, &scurve);
+        else
+            shaper_move_trapezoid(&move, &shaper, &trapezoid);
+
+        if((n = build_stream(&move, (uint32_t)(segment_us * 1e-6 * TIMER_CLOCK))) != steps)
+        {
+            fprintf(stderr, "%s: %u of %u steps\n", name[type], n, steps);
+            failed = true;
+            continue;
+        }
+
+        resonate(steps, 1.0 / steps_per_mm, hz, zeta, tolerance, &result);
+        if(type == Shaper_None)
+            unshaped = result.end;
+        printf("%-6s %10.3f %10.3f %12.2f %12.2f\n", name[type], result.end * 1e3, (result.end - unshaped) * 1e3,
+               result.residual * 1e3, result.settle * 1e3);
+    }
+
+    // Shapers tuned to hz while the real resonance is off by the detune factor
+    printf("\nresidual um with the resonance off tune\n%-6s", "shaper");
+    for(d = 0; d < sizeof(detune) / sizeof(detune[0]); d++)
+        printf(" %9.0f%%", detune[d] * 100.0);
+    printf("\n");
+
+    for(type = Shaper_None; type <= Shaper_ZVD; type++)
+    {
+        shaper_init(&shaper, (shaper_type_t)type, hz, zeta);
+        if(jerk > 0.0)
+            shaper_move_scurve(&move, &shaper, &scurve);
+        else
+            shaper_move_trapezoid(&move, &shaper, &trapezoid);
+        if(build_stream(&move, (uint32_t)(segment_us * 1e-6 * TIMER_CLOCK)) != steps)
+            continue;
+
+        printf("%-6s", name[type]);
+        for(d = 0; d < sizeof(detune) / sizeof(detune[0]); d++)
+        {
+            resonate(steps, 1.0 / steps_per_mm, hz * detune[d], zeta, tolerance, &result);
+            printf(" %10.2f", result.residual * 1e3);
+        }
+        printf("\n");
+    }
+
+    // Cost of the producer side, the stepper thread builds these segments while the move runs
+    printf("\nsegment cost\n");
+    for(type = Shaper_None; type <= Shaper_ZVD; type++)
+    {
+        shaper_init(&shaper, (shaper_type_t)type, hz, zeta);
+        if(jerk > 0.0)
+            shaper_move_scurve(&move, &shaper, &scurve);
+        else
+            shaper_move_trapezoid(&move, &shaper, &trapezoid);
+
+        segments = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for(n = 0; n < 20; n++)
+        {
+            uint32_t i = 0, ticks;
+
+            while(i < steps)
+            {
+                i += shaper_segment(&move, i, (uint32_t)(segment_us * 1e-6 * TIMER_CLOCK), TIMER_CLOCK, &ticks);
+                segments++;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+        printf("%-6s %10u segments %10.0f ns/segment\n", name[type], segments / 20, ns / segments);
+    }
+
+    free(tick);
+
+    return failed ? 1 : 0;
+}
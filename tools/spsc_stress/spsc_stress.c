@@ -0,0 +1,228 @@
+/*
+ * spsc_stress.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Host stress test for the SPSC ring (spsc_ring.h), a producer and a consumer thread.
+ *
+ *  The producer writes sequence numbered elements, one at a time through reserve/commit and
+ *  in runs of random length through put_bulk, the consumer takes them with peek/release and
+ *  checks that every element arrives once, in order and whole. The indices start just below
+ *  the 32 bit wrap so they also wrap during the run. Both sides check the bounds of
+ *  spsc_ring_count and spsc_ring_free against what they then manage to put or take.
+ *
+ *  Build (from the repository root):
+ *
+ *    gcc -O2 -pthread -Isource -o spsc_stress tools/spsc_stress/spsc_stress.c \
+ *        source/spsc_ring.c
+ *
+ *  Adding -fsanitize=thread also checks the ordering of the ring accesses.
+ *
+ *  Usage:
+ *
+ *    spsc_stress [-n elements] [-c capacity]
+ *
+ *    -n  elements passed through the ring (default 5000000)
+ *    -c  capacity of the ring, a power of two (default 16)
+ *
+ *  Exit status is 1 if an element is lost, repeated, out of order or torn, or a count is off.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "spsc_ring.h"
+
+#define CAPACITY_MAX 4096
+#define BULK_MAX 64
+
+// Indices start this far below the 32 bit wrap
+#define WRAP_AHEAD 1000
+
+// Polls of a full or empty ring before the thread sleeps, lets the other side run on one core
+#define SPINS_MAX 1000
+
+typedef struct {
+    uint32_t seq;
+    uint32_t check[3];              // Derived from seq, a torn element does not match
+} element_t;
+
+static spsc_ring_t ring;
+static element_t storage[CAPACITY_MAX];
+static uint32_t capacity = 16;
+static uint64_t elements = 5000000;
+
+static volatile uint64_t producer_errors, consumer_errors;
+
+static void element_fill(element_t *element, uint32_t seq)
+{
+    element->seq = seq;
+    element->check[0] = ~seq;
+    element->check[1] = seq * 2654435761U;
+    element->check[2] = seq ^ 0xa5a5a5a5U;
+}
+
+static int element_ok(const element_t *element, uint32_t seq)
+{
+    return element->seq == seq && element->check[0] == ~seq && element->check[1] == seq * 2654435761U &&
+            element->check[2] == (seq ^ 0xa5a5a5a5U);
+}
+
+static void wait_other_side(uint32_t *spins)
+{
+    static const struct timespec pause = { 0, 1000 };
+
+    if(++*spins >= SPINS_MAX) {
+        nanosleep(&pause, NULL);
+        *spins = 0;
+    }
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return *state;
+}
+
+static void *producer(void *arg)
+{
+    element_t bulk[BULK_MAX];
+    uint32_t seq = 0, seed = 0x12345678, spins = 0, count, free, n, added, idx;
+    element_t *slot;
+
+    (void)arg;
+
+    while(seq < elements && !consumer_errors) {
+
+        count = spsc_ring_count(&ring);
+        free = spsc_ring_free(&ring);
+
+        // Upper bound of the count, the consumer only takes
+        if(count > capacity || free > capacity) {
+            fprintf(stderr, "producer: count %u free %u of %u\n", count, free, capacity);
+            producer_errors++;
+            return NULL;
+        }
+
+        if(next_random(&seed) & 1) {
+            if((slot = spsc_ring_reserve(&ring)) == NULL) {
+                // Free is a lower bound, there was no room when it was read either
+                if(free) {
+                    fprintf(stderr, "producer: ring full with %u free\n", free);
+                    producer_errors++;
+                    return NULL;
+                }
+                wait_other_side(&spins);
+                continue;
+            }
+            element_fill(slot, seq++);
+            spsc_ring_commit(&ring);
+        } else {
+            n = 1 + next_random(&seed) % BULK_MAX;
+            if(n > elements - seq)
+                n = (uint32_t)(elements - seq);
+            for(idx = 0; idx < n; idx++)
+                element_fill(&bulk[idx], seq + idx);
+
+            added = spsc_ring_put_bulk(&ring, bulk, n);
+            if(added < (n < free ? n : free)) {
+                fprintf(stderr, "producer: %u of %u added with %u free\n", added, n, free);
+                producer_errors++;
+                return NULL;
+            }
+            if(added == 0)
+                wait_other_side(&spins);
+            seq += added;
+        }
+    }
+
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    uint32_t seq = 0, spins = 0, count;
+    element_t *element;
+
+    (void)arg;
+
+    while(seq < elements && !producer_errors) {
+
+        count = spsc_ring_count(&ring);
+
+        if(count > capacity) {
+            fprintf(stderr, "consumer: count %u of %u\n", count, capacity);
+            consumer_errors++;
+            return NULL;
+        }
+
+        // Lower bound of the count, at least that many are there to take
+        do {
+            if((element = spsc_ring_peek(&ring)) == NULL) {
+                if(count) {
+                    fprintf(stderr, "consumer: ring empty with %u counted\n", count);
+                    consumer_errors++;
+                    return NULL;
+                }
+                wait_other_side(&spins);
+                break;
+            }
+            if(!element_ok(element, seq)) {
+                fprintf(stderr, "consumer: element %u expected, got %u%s\n", seq, element->seq,
+                        element->seq == seq ? " torn" : "");
+                consumer_errors++;
+                return NULL;
+            }
+            spsc_ring_release(&ring);
+            seq++;
+        } while(count && --count);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[2];
+    uint32_t start = UINT32_MAX - WRAP_AHEAD;
+    int arg;
+
+    for(arg = 1; arg < argc; arg++) {
+        if(!strcmp(argv[arg], "-n") && arg + 1 < argc)
+            elements = strtoull(argv[++arg], NULL, 10);
+        else if(!strcmp(argv[arg], "-c") && arg + 1 < argc)
+            capacity = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        else {
+            fprintf(stderr, "usage: %s [-n elements] [-c capacity]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if(elements > UINT32_MAX || capacity > CAPACITY_MAX || !spsc_ring_init(&ring, storage, capacity, sizeof(element_t))) {
+        fprintf(stderr, "elements up to 2^32 - 1, capacity a power of two up to %u\n", CAPACITY_MAX);
+        return 2;
+    }
+
+    atomic_store(&ring.head, start);
+    atomic_store(&ring.tail, start);
+
+    pthread_create(&threads[1], NULL, consumer, NULL);
+    pthread_create(&threads[0], NULL, producer, NULL);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+
+    printf("elements     : %llu\n", (unsigned long long)elements);
+    printf("capacity     : %u\n", capacity);
+    printf("indices      : 0x%08x to 0x%08x\n", start, atomic_load(&ring.head));
+    printf("result       : %s\n", producer_errors || consumer_errors ? "FAILED" : "ok");
+
+    return producer_errors || consumer_errors ? 1 : 0;
+}
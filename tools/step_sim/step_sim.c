@@ -0,0 +1,595 @@
+/*
+ * step_sim.c
+ *
+ *  Created on: 17 okt. 2026
+ *      Author: perra
+ *
+ *  Host test of the base motion path. The planner and stepper threads and the step ISR run
+ *  as they do on the target, on the step timer simulation (step_timer.c, STEP_TIMER_SIM) and
+ *  the FreeRTOS stand-in of tools/host. A test task takes the place of the g-code thread, it
+ *  sends parser blocks to the planner queue and waits on xMoveReady like M400 does.
+ *
+ *  Every step event is time stamped and checked against the profile the move was planned on,
+ *  motion_profile.c, from the first step on. A move from idle that nothing follows has to
+ *  start without the start delay of the stepper thread. Outputs switched along a move have to
+ *  latch the position of the step event at their distance, also the output of a record of the
+ *  binary port. Feed hold has to stop the axes within their stopping distance, keep them
+ *  still and finish the move at its target after the resume. A stream of short moves, sent
+ *  from above the planner like the g-code thread does, has to run through the planner ring
+ *  while it is full, without slowing down at the junctions between them. Run dry by a stepper
+ *  thread held up, it has to ramp down, wait and ramp up again from rest by itself. A move
+ *  submitted just as the one before ends must keep the ready bits clear until it is stepped
+ *  out.
+ *
+ *  Build (from the repository root):
+ *
+ *    gcc -O1 -DSTEP_TIMER_SIM -Itools/host -Isource -Isource/GCode -Isource/Network \
+ *        -o step_sim tools/step_sim/step_sim.c tools/host/host_rtos.c tools/host/host_sdk.c \
+ *        source/GCode/stepper.c source/GCode/planner.c source/GCode/settings.c \
+ *        source/GCode/step_timer.c source/GCode/step_pins.c source/GCode/nuts_bolts.c \
+ *        source/GCode/motion_profile.c source/GCode/shaper.c source/GCode/motion_control.c \
+ *        source/GCode/GCode.c source/Network/binary_record.c source/spsc_ring.c -lm
+ *
+ *  Usage:
+ *
+ *    step_sim [-v]
+ *
+ *    -v  print the worst timing error of every check
+ *
+ *  Exit status is 1 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "PnPContoller_Main.h"
+#include "binary_protocol.h"
+#include "step_timer.h"
+#include "fsl_common.h"
+
+// Worst step time error allowed against the profile, timer ticks and rounding of the
+// recurrence. The first step is the reference.
+#define TIME_ERROR_MAX_US 50.0
+
+// Submit of a move from idle to its first step, past the first period from rest
+#define START_LATENCY_MAX_MS 1.0
+
+// Outputs switched along the move of the output check
+#define OUTPUTS 4
+
+// Moves of the stream check, three times the planner ring
+#define STREAM_MOVES (3 * BLOCK_BUFFER_SIZE)
+#define STREAM_MOVE_MM 0.5f
+#define STREAM_FEED 6000.0f
+#define STREAM_PERIOD_MAX 1.1f          // Longest step period between the ramps, of the planned one
+#define STREAM_PRIO 10                  // The g-code thread, above the planner
+
+// Stepper thread held up during the underrun check, from the start of the stream
+#define HOG_AFTER_MS 200
+#define HOG_MS 300
+
+// Shortest ratio of a step period to the one before, the second one from rest is sqrt(2) - 1
+#define RAMP_RATIO_MIN 0.4f
+
+// Submit times of the ready bit race check around the end of the move before, in ticks
+#define RACE_BEFORE_TICKS (40 * HOST_RTOS_CALL_TICKS)
+#define RACE_AFTER_TICKS (4 * HOST_RTOS_CALL_TICKS)
+#define RACE_STEP_TICKS 7
+
+// Step events traced per axis and check
+#define STEPS_MAX 100000
+
+extern axis_t Axis_X, Axis_Y;
+
+// Firmware globals defined by the modules not built on the host
+controllerBoard_t BaseController = { MOVE_READY_BASE };
+controllerBoard_t HeadController = { MOVE_READY_HEAD };
+controllerBoard_t Feeder1Controller = { MOVE_READY_FEEDER1 };
+controllerBoard_t Feeder2Controller = { MOVE_READY_FEEDER2 };
+EventGroupHandle_t xMoveReady;
+QueueHandle_t xPlannerQueue;
+volatile uint_fast16_t sys_rt_exec_alarm;
+
+static axis_t * const axes[N_BASE_AXIS] = { &Axis_X, &Axis_Y };
+
+// Step events of each axis since the last trace_reset()
+static struct {
+    uint64_t time[N_BASE_AXIS][STEPS_MAX];
+    uint32_t steps[N_BASE_AXIS];
+    int32_t position[N_BASE_AXIS];
+    bool full;                          // Planner ring seen full by the step ISR
+} trace;
+
+static float position[N_BASE_AXIS];     // Target of the last move, mm
+static int failures;
+static bool verbose;
+
+static void step_event(uint64_t time)
+{
+    uint_fast8_t idx;
+
+    trace.full |= plan_check_full_buffer();
+
+    for(idx = 0; idx < N_BASE_AXIS; idx++) {
+        if((int32_t)axes[idx]->ActualPos != trace.position[idx]) {
+            trace.position[idx] = (int32_t)axes[idx]->ActualPos;
+            if(trace.steps[idx] < STEPS_MAX)
+                trace.time[idx][trace.steps[idx]++] = time;
+        }
+    }
+}
+
+static void trace_reset(void)
+{
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < N_BASE_AXIS; idx++) {
+        trace.steps[idx] = 0;
+        trace.position[idx] = (int32_t)axes[idx]->ActualPos;
+    }
+    trace.full = false;
+}
+
+static void check(const char *name, bool ok)
+{
+    printf("%-44s: %s\n", name, ok ? "ok" : "FAILED");
+    if(!ok)
+        failures++;
+}
+
+//
+// Hand a G0 or G1 to the planner, like the g-code thread
+static void move_outputs(float x, float y, float feed, bool rapid, const output_command_t *outputs, uint8_t n)
+{
+    parser_block_t block;
+
+    memset(&block, 0, sizeof(parser_block_t));
+    memcpy(block.output_commands, outputs, n * sizeof(output_command_t));
+    block.n_output_commands = n;
+    block.modal.motion = rapid ? MotionMode_Seek : MotionMode_Linear;
+    block.values.f = feed;
+    block.values.xyz[X_AXIS] = position[X_AXIS] = x;
+    block.values.xyz[Y_AXIS] = position[Y_AXIS] = y;
+    block.controlers.Ctrl_Base = true;
+    block.axis_words = X_AXIS_BIT | Y_AXIS_BIT;
+
+    xQueueSend(xPlannerQueue, &block, portMAX_DELAY);
+}
+
+static void move(float x, float y, float feed, bool rapid)
+{
+    move_outputs(x, y, feed, rapid, NULL, 0);
+}
+
+//
+// Wait until the base has stepped out everything, like M400
+static void wait_ready(void)
+{
+    xEventGroupWaitBits(xMoveReady, MOVE_READY_BASE | MOVE_READY_BASE_AXES, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+static bool at_target(void)
+{
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < N_BASE_AXIS; idx++) {
+        if((int32_t)axes[idx]->ActualPos != lroundf(position[idx] * settings.axis[idx].steps_per_mm))
+            return false;
+    }
+
+    return true;
+}
+
+//
+// Wait until the last move is at its target, when the ready bits cannot be trusted
+static void wait_ready_stepped(void)
+{
+    while(!at_target())
+        vTaskDelay(1);
+    wait_ready();
+}
+
+//
+// Worst error of the step times of an axis against a profile, both taken from its first step
+static double time_error_us(uint_fast8_t idx, const motion_profile_t *profile)
+{
+    double error, worst = 0.0, clock = step_timer_clock();
+    uint32_t step;
+
+    for(step = 1; step <= trace.steps[idx] && step <= profile->steps; step++) {
+        error = (double)(trace.time[idx][step - 1] - trace.time[idx][0]) / clock -
+                (profile_time(profile, step) - profile_time(profile, 1));
+        if(fabs(error) > fabs(worst))
+            worst = error;
+    }
+
+    return worst * 1e6;
+}
+
+static bool timing_ok(const char *name, uint_fast8_t idx, const motion_profile_t *profile)
+{
+    double error = time_error_us(idx, profile);
+
+    if(verbose || trace.steps[idx] != profile->steps || fabs(error) > TIME_ERROR_MAX_US)
+        printf("  %s: %u of %u steps, worst error %.1f us\n", name, trace.steps[idx], profile->steps, error);
+
+    return trace.steps[idx] == profile->steps && fabs(error) <= TIME_ERROR_MAX_US;
+}
+
+//
+// Profile the planner gives a single G1 from rest to rest, in step events of the dominant axis
+static void coordinated_profile(motion_profile_t *profile, const float *from, float feed)
+{
+    float delta[N_BASE_AXIS], length = 0.0f, acceleration = 1e30f, rate = feed / 60.0f, scale;
+    uint32_t steps = 0;
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < N_BASE_AXIS; idx++) {
+        delta[idx] = (float)(lroundf(position[idx] * settings.axis[idx].steps_per_mm) -
+                             lroundf(from[idx] * settings.axis[idx].steps_per_mm));
+        steps = max(steps, (uint32_t)fabsf(delta[idx]));
+        delta[idx] /= settings.axis[idx].steps_per_mm;
+        length += delta[idx] * delta[idx];
+    }
+    length = sqrtf(length);
+
+    for(idx = 0; idx < N_BASE_AXIS; idx++) {
+        if(delta[idx] != 0.0f) {
+            acceleration = min(acceleration, settings.axis[idx].acceleration * length / fabsf(delta[idx]));
+            rate = min(rate, settings.axis[idx].max_rate / 60.0f * length / fabsf(delta[idx]));
+        }
+    }
+
+    scale = (float)steps / length;
+    profile_calculate(profile, steps, 0.0f, rate * scale, 0.0f, acceleration * scale);
+}
+
+//
+// Profile of one axis of an async rapid
+static void async_profile(motion_profile_t *profile, uint_fast8_t idx, const float *from)
+{
+    uint32_t steps = labs(lroundf(position[idx] * settings.axis[idx].steps_per_mm) -
+                          lroundf(from[idx] * settings.axis[idx].steps_per_mm));
+
+    profile_calculate(profile, steps, 0.0f, settings.axis[idx].max_rate / 60.0f * settings.axis[idx].steps_per_mm,
+                      0.0f, settings.axis[idx].acceleration * settings.axis[idx].steps_per_mm);
+}
+
+static void test_coordinated(void)
+{
+    float from[N_BASE_AXIS];
+    motion_profile_t profile;
+    uint64_t submitted;
+    double latency;
+    float rest;
+
+    memcpy(from, position, sizeof(from));
+    trace_reset();
+    submitted = host_rtos_now();
+    move(50.0f, 12.5f, 12000.0f, false);
+    wait_ready();
+
+    coordinated_profile(&profile, from, 12000.0f);
+    check("coordinated G1, step times", timing_ok("X", X_AXIS, &profile));
+    check("coordinated G1, at target", at_target());
+
+    // Nothing follows it, the first period from rest starts right away
+    rest = sqrtf(2.0f / (settings.axis[X_AXIS].acceleration * settings.axis[X_AXIS].steps_per_mm));
+    latency = (double)(trace.time[X_AXIS][0] - submitted) / step_timer_clock() - rest;
+    if(verbose)
+        printf("  X: first step %.3f ms after the submit, past the period from rest\n", latency * 1000.0);
+    check("coordinated G1, started without the delay", trace.steps[X_AXIS] && latency * 1000.0 < START_LATENCY_MAX_MS);
+}
+
+//
+// M62/M63 along a G1, switched with the step event at their distance. The position latched
+// is the one after that step. Outputs must not change the step times.
+static void test_outputs(void)
+{
+    static const struct {
+        float distance;
+        uint8_t port;
+        int32_t value;
+        uint32_t step;              // Step event of the move it switches with
+    } outputs[] = {
+        { 0.0f, 0, 1, 0 },
+        { 12.5f, 1, 1, 1000 },
+        { 12.5f, 2, 0, 1000 },
+        { -0.0125f, 3, 1, 3999 }    // One step back from the end
+    };
+    output_command_t commands[GC_MAX_OUTPUTS];
+    float from[N_BASE_AXIS];
+    motion_profile_t profile;
+    output_latch_t latch;
+    int32_t start = (int32_t)Axis_X.ActualPos;
+    uint32_t idx, latched = 0;
+    bool ok = true;
+
+    memset(commands, 0, sizeof(commands));
+    for(idx = 0; idx < OUTPUTS; idx++) {
+        commands[idx].is_digital = true;
+        commands[idx].port = outputs[idx].port;
+        commands[idx].value = outputs[idx].value;
+        commands[idx].distance = outputs[idx].distance;
+    }
+
+    memcpy(from, position, sizeof(from));
+    trace_reset();
+    move_outputs(position[X_AXIS] + 50.0f, position[Y_AXIS], 12000.0f, false, commands, OUTPUTS);
+    wait_ready();
+
+    while(stepper_output_latched(&latch)) {
+        if(verbose)
+            printf("  output %u = %u latched at X step %ld\n", latch.port, latch.value, (long)(latch.position[X_AXIS] - start));
+        ok &= latched < OUTPUTS && latch.port == outputs[latched].port && latch.value == outputs[latched].value &&
+              latch.position[X_AXIS] - start == (int32_t)outputs[latched].step + 1;
+        latched++;
+    }
+
+    coordinated_profile(&profile, from, 12000.0f);
+    check("outputs, latched after their step event", ok && latched == OUTPUTS);
+    check("outputs, step times", timing_ok("X", X_AXIS, &profile));
+}
+
+static void test_async(void)
+{
+    float from[N_BASE_AXIS];
+    motion_profile_t profile[N_BASE_AXIS];
+
+    memcpy(from, position, sizeof(from));
+    trace_reset();
+    move(150.0f, -7.5f, 0.0f, true);
+    wait_ready();
+
+    async_profile(&profile[X_AXIS], X_AXIS, from);
+    async_profile(&profile[Y_AXIS], Y_AXIS, from);
+    check("async G0, step times of X", timing_ok("X", X_AXIS, &profile[X_AXIS]));
+    check("async G0, step times of Y", timing_ok("Y", Y_AXIS, &profile[Y_AXIS]));
+    check("async G0, at target", at_target());
+}
+
+//
+// A record of the binary port with an output, mapped and queued the way the port does
+static void test_binary(void)
+{
+    bin_block_t record;
+    parser_block_t block;
+    output_latch_t latch;
+    status_code_t status;
+    int32_t start = (int32_t)Axis_X.ActualPos;
+    uint32_t latched = 0;
+    bool ok = true;
+
+    memset(&record, 0, sizeof(record));
+    record.sync = BIN_SYNC;
+    record.type = BinRecord_Block;
+    record.motion = MotionMode_Linear;
+    record.controllers = BIN_CTRL_BASE;
+    record.f = 12000.0f;
+    record.xyz[X_AXIS] = position[X_AXIS] += 50.0f;
+    record.xyz[Y_AXIS] = position[Y_AXIS];
+    record.output_value = 1;
+    record.output_distance = 12.5f;
+    record.output_port = 1;
+    record.output_flags = BIN_OUTPUT_VALID | BIN_OUTPUT_DIGITAL;
+    record.checksum = calc_checksum((uint8_t *)&record, offsetof(bin_block_t, checksum));
+
+    if((status = binary_record_block(&record, &block)) == Status_OK)
+        status = mc_line(&block);
+    wait_ready();
+
+    while(stepper_output_latched(&latch)) {
+        if(verbose)
+            printf("  output %u = %u latched at X step %ld\n", latch.port, latch.value, (long)(latch.position[X_AXIS] - start));
+        ok &= latch.port == 1 && latch.value == 1 && latch.position[X_AXIS] - start == 1001;
+        latched++;
+    }
+
+    check("binary record, output latched at Q", status == Status_OK && ok && latched == 1);
+    check("binary record, at target", at_target());
+}
+
+static void test_feed_hold(void)
+{
+    float rate = 12000.0f / 60.0f * settings.axis[X_AXIS].steps_per_mm;
+    float stop = rate * rate / (2.0f * settings.axis[X_AXIS].acceleration * settings.axis[X_AXIS].steps_per_mm);
+    uint32_t held, steps;
+
+    trace_reset();
+    move(0.0f, 0.0f, 12000.0f, false);
+
+    // Into the cruise, then hold
+    host_rtos_delay_ticks(USEC_TO_COUNT(400000, step_timer_clock()));
+    steps = trace.steps[X_AXIS];
+    stepper_feed_hold();
+    while(stepper_hold_state() != Hold_Complete)
+        vTaskDelay(1);
+    held = trace.steps[X_AXIS];
+
+    if(verbose)
+        printf("  X: %u steps to rest, %.0f planned\n", held - steps, stop);
+    check("feed hold, stops within the stop distance", held - steps <= (uint32_t)stop + 2);
+
+    vTaskDelay(100);
+    check("feed hold, still while held", trace.steps[X_AXIS] == held && !(xEventGroupGetBits(xMoveReady) & MOVE_READY_BASE));
+
+    stepper_cycle_start();
+    wait_ready();
+    check("feed hold, resumed to the target", at_target());
+}
+
+//
+// More short moves than the planner ring holds, the planner thread waits for room. They are
+// colinear, so once up to speed X keeps the feed rate through every junction between them.
+static void stream_task(void *arg)
+{
+    uint32_t idx;
+
+    for(idx = 0; idx < STREAM_MOVES; idx++)
+        move(position[X_AXIS] + STREAM_MOVE_MM, position[Y_AXIS], STREAM_FEED, false);
+
+    xTaskNotifyGive((TaskHandle_t)arg);
+}
+
+//
+// Send the stream of short moves from above the planner, like the g-code thread parsing a full
+// input buffer. The planner queue only runs empty at the end, the stepper starts without its
+// start delay when it does.
+static void stream(void)
+{
+    sys_thread_new("stream", stream_task, xTaskGetCurrentTaskHandle(), 1000, STREAM_PRIO);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    wait_ready();
+}
+
+static void test_stream(void)
+{
+    float rate = STREAM_FEED / 60.0f, ramp, period, slowest = 0.0f;
+    uint32_t idx, from, to;
+
+    trace_reset();
+    stream();
+
+    check("stream, planner ring filled and drained", trace.full && at_target());
+
+    // Steps of the ramps at both ends, and a move more
+    ramp = (rate * rate / (2.0f * settings.axis[X_AXIS].acceleration) + STREAM_MOVE_MM) * settings.axis[X_AXIS].steps_per_mm;
+    period = (float)step_timer_clock() / (rate * settings.axis[X_AXIS].steps_per_mm);
+    from = (uint32_t)ramp;
+    to = trace.steps[X_AXIS] - (uint32_t)ramp;
+    for(idx = from + 1; idx < to; idx++)
+        slowest = max(slowest, (float)(trace.time[X_AXIS][idx] - trace.time[X_AXIS][idx - 1]));
+
+    if(verbose)
+        printf("  X: longest step period at feed %.0f ticks, %.0f planned\n", slowest, period);
+    check("stream, colinear junctions at the feed rate", from < to && slowest < period * STREAM_PERIOD_MAX);
+}
+
+//
+// Keeps the stepper thread from running, the step ISR goes on
+static void hog_task(void *arg)
+{
+    uint64_t until;
+
+    (void)arg;
+
+    vTaskDelay(HOG_AFTER_MS);
+    until = host_rtos_now() + (uint64_t)HOG_MS * step_timer_clock() / 1000;
+    while(host_rtos_now() < until)
+        (void)xEventGroupGetBits(xMoveReady);
+}
+
+//
+// The stream again with the stepper thread held up long enough for the segment ring to run
+// dry. The underrun hold has to resume by itself once it has caught up, and no period may be
+// shorter than the ramp from rest allows, also where the stream starts again.
+static void test_underrun(void)
+{
+    stepper_stats_t stats;
+    float ratio = 1.0f, rest, period, before;
+    uint32_t idx;
+
+    stepper_reset_stats();
+    trace_reset();
+    sys_thread_new("hog", hog_task, NULL, 1000, 11);
+    stream();
+    stepper_get_stats(&stats);
+
+    // A pause counts as the first period from rest, at the acceleration of X
+    rest = sqrtf(2.0f / (settings.axis[X_AXIS].acceleration * settings.axis[X_AXIS].steps_per_mm)) * step_timer_clock();
+    for(idx = 2; idx < trace.steps[X_AXIS]; idx++) {
+        period = (float)(trace.time[X_AXIS][idx] - trace.time[X_AXIS][idx - 1]);
+        before = (float)(trace.time[X_AXIS][idx - 1] - trace.time[X_AXIS][idx - 2]);
+        ratio = min(ratio, period / min(before, rest));
+    }
+
+    if(verbose)
+        printf("  %u near underruns, %u underruns, shortest period ratio %.3f\n", stats.near_underruns,
+               stats.underruns[X_AXIS], ratio);
+    check("underrun, resumed to the target", stats.near_underruns && at_target());
+    check("underrun, restarted from rest", ratio >= RAMP_RATIO_MIN);
+}
+
+//
+// A move submitted while the one before steps out must not let its ready bits through. The
+// submit is swept across the end of that move in steps shorter than an RTOS call, so the
+// last step event lands in every window of submitMoveBase().
+static void test_ready_race(void)
+{
+    uint64_t start, end, delay;
+    uint32_t early = 0;
+
+    // Length of a 1 mm move from the submit to the ready bits
+    start = host_rtos_now();
+    move(position[X_AXIS] + 1.0f, position[Y_AXIS], 6000.0f, false);
+    wait_ready();
+    end = host_rtos_now() - start;
+
+    for(delay = end - RACE_BEFORE_TICKS; delay < end + RACE_AFTER_TICKS; delay += RACE_STEP_TICKS) {
+        move(position[X_AXIS] - 1.0f, position[Y_AXIS], 6000.0f, false);
+        host_rtos_delay_ticks(delay);
+        move(position[X_AXIS] + 1.0f, position[Y_AXIS], 6000.0f, false);
+        wait_ready();
+        if(!at_target()) {
+            early++;
+            wait_ready_stepped();
+        }
+    }
+
+    if(verbose || early)
+        printf("  ready before the move was stepped out %u times\n", early);
+    check("ready bits, submit at the end of a move", early == 0);
+}
+
+static void test_task(void *arg)
+{
+    (void)arg;
+
+    // The planner thread creates its queue and waits a second before it takes blocks
+    vTaskDelay(1100);
+
+    test_coordinated();
+    test_outputs();
+    test_binary();
+    test_async();
+    test_feed_hold();
+    test_stream();
+    test_underrun();
+    test_ready_race();
+
+    printf("%-44s: %s\n", "result", failures ? "FAILED" : "ok");
+    exit(failures ? 1 : 0);
+}
+
+int main(int argc, char **argv)
+{
+    int arg;
+
+    for(arg = 1; arg < argc; arg++) {
+        if(!strcmp(argv[arg], "-v"))
+            verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    settings_init();
+    xMoveReady = xEventGroupCreate();
+    xEventGroupSetBits(xMoveReady, MOVE_READY_ALL);
+
+    stepper_init();
+    planner_init();
+
+    // Below the planner thread, a block sent is planned before the test goes on
+    sys_thread_new("test", test_task, NULL, 1000, 8);
+    step_timer_sim_trace(step_event);
+
+    host_rtos_run(UINT64_MAX);
+
+    fprintf(stderr, "tasks blocked before the tests were done\n");
+
+    return 1;
+}